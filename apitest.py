@@ -29,7 +29,7 @@ def KErrDie(*args, **kwargs):
 
 def ParseCommandLine(mp):
 	parser= argparse.ArgumentParser(description='Generate a random file for use in apitest.py or ccsearch')
-	parser.add_argument('-f',help='Specify input file.  Must be in columns, delimited by single-delimiters (comma by default, otherwise see -d option).  May have a header (see -H option).  Blank lines are ignored as is anything after a #.  Columns are ID, Value, Cost, Feature membership 1..n (each of which specifies the feature group it is a member of or - for none or a : delimited list of groups if multiple (for nonpartition features)).  Note that there must be at least one feature.  Values and costs must be >-999998.  There must be <32768 items.  Feature groups for items must be >=1.  Mandatory.',type=str, required=True)
+	parser.add_argument('-f',help='Specify input file.  Must be in columns, delimited by single-delimiters (comma by default, otherwise see -d option).  May have a header (see -H option).  Blank lines are ignored as is anything after a #.  Columns are ID, Value, Cost, Feature membership 1..n (each of which specifies the feature group it is a member of or - for none or a : delimited list of groups if multiple (for nonpartition features)).  Note that there must be at least one feature.  Values and costs must be >-999998.  Feature groups for items must be >=1.  Mandatory.',type=str, required=True)
 	parser.add_argument('-H',help='The input file has a header. Basically, we ignore the first line. Cannot be :',action='store_true',required=False,default=',')
 	parser.add_argument('-d',help='Specify delimiter char for input file.  Note that adjacent delimiters are non concatenated (one delimiter between columns).  Default is comma.  For tab-delimited, type the word tab.',type=str, default= ',')
 	parser.add_argument('-P',help='Specify which feature is the Primary one (see the algo description for details of what this means).  Features are numbered from 1..n based on the columns of the input file. Mandatory.',type=str, required=True)
@@ -44,8 +44,27 @@ def ParseCommandLine(mp):
 	parser.add_argument('--resnumb',help='Specify the block allocation size (in number of collections) used by the memory manager.  Rarely necessary to specify.  Default is 10000.'  ,type=int,default=10000)
 	parser.add_argument('--maxres',help='Specify the maximum number of collections to return/keep.  If 0, no maximum.  Note that this has an effect even if no output is specified because it controls what we keep internally.  Default is 10000.',type=int,default=10000)
 	parser.add_argument('--smode',help='Specify the search mode.  There are 4 choices based on 2 main decisions:  do we move from primary groups with the least combos to most or vice versa, and do we select combos of items within a group in order of decreasing value or increasing cost.  The choices are 1=  Fewest-to-most combinations / Decreasing Value,  2=  Most-to-fewest combinations / Decreasing Value, 3=  Fewest-to-most combinations / Increasing Cost, 4=  Most-to-fewest combinations / Increasing Cost.  Default is 1.',type=int, default=1)
+	parser.add_argument('--threads',help='Specify the number of search threads.  1 runs the ordinary serial search.  More splits the search tree into tasks which are shared out among the threads.  The value ranking of the results is unaffected.  Default is 1.',type=int, default=1)
 	parser.add_argument('-o',help='Specify output file for results.  This will contain the best maxres (or fewer) collections obtained, along with their values.  If omitted, no results are output.  Use stdout for standard out.',type=str, required=False,default='')
 	parser.add_argument('--mctol',help='To avoid rounding issues when checking a sum of costs against maxcost, we require that it be <= maxcost+mctol.  The default for mctol is 0.01, which is fine for integer costs.  However, for smaller discretizations it should be made smaller --- and for general float costs, it should be set to 0.  Default is 0.01.',type=float, default=0.01)
+	parser.add_argument('--bmode',help='Specify the bound used to prune the search.  0 is the classic bound, which takes the best values and lowest costs of the remaining groups separately.  1 uses tables of the best value obtainable for each amount of remaining budget, which prune much more when the maximum cost binds.  Default is 0.',type=int, default=0)
+	parser.add_argument('--nbins',help='Specify the number of cost bins in the budget tables used by --bmode 1.  More bins give a tighter bound but take longer to build.  Default is 1000.',type=int, default=1000)
+	parser.add_argument('--gtol',help='Specify the combo cull tolerance.  This is like --itol, but for the combos of items picked from each primary group.  A combo is culled if there are at least 1+gntol others with lower or equal cost and value more than gtol higher (as a fraction).  If <0, no combo cull is performed.  Default is -1.',type=float, default=-1)
+	parser.add_argument('--gntol',help='Specify the number of extra combos to require in the combo cull (see --gtol).  Default is 0.',type=int, default=0)
+	parser.add_argument('--maxcombos',help='Keep at most this many combos (the best in scan order) for each primary group.  Combos are generated best first, so this bounds the memory taken by a group with a huge number of them, but collections needing a combo past the cap are lost.  0 means no limit.  Default is 0.',type=int, default=0)
+	parser.add_argument('--timeout',help='Specify a time limit for the search in seconds.  If it runs out, we stop and return the collections found so far.  0 means no limit.  Default is 0.',type=float, default=0)
+	parser.add_argument('--maxanal',help='Specify the maximum number of collections to analyze (i.e. which survive pruning).  Once reached, we stop and return the collections found so far.  0 means no limit.  Default is 0.',type=int, default=0)
+	parser.add_argument('--plan',help='Specify the search plan explicitly, overriding smode.  This is of the form g1s1:g2s2:... listing every primary feature group (numbered from 1) in the order to search them, each followed by v to scan its combos by decreasing value or c to scan them by increasing cost.  Ex. 3v:1v:2c.  The plan chosen by --autotune is reported in this form.',type=str, default='')
+	parser.add_argument('--autotune',help='Choose the search plan automatically.  We run a short probe search of this many combos for each of a set of candidate plans and use the one which covers the most of the state space per combo.  The plan chosen is reported (see --plan).  0 means no tuning.  Default is 0.',type=int, default=0)
+	parser.add_argument('--warmstart',help='Seed the search with up to this many collections found greedily beforehand, so it can prune by value from the start.  0 means no warm start.  Default is 0.',type=int, default=0)
+	parser.add_argument('--combocache',help='Specify the most combos the combo cache may hold.  The combos of each primary group are kept across searches in the same process, so a slate searched again only needs their sums and order recomputed.  A group with more combos than this is never cached.  0 disables the cache.  Default is 2097152.',type=int, default=2097152)
+	parser.add_argument('--scalar',help='Skip runs of combos with the plain scan loop rather than the vectorized one.  The results are identical, so this is only useful for checking the two against each other.',action='store_true',default=False)
+	parser.add_argument('--spillmb',help='With maxres 0, spill the results to a scratch file once they take this many MB of memory, and merge them back when reading them.  0 means never spill.  Default is 0.',type=int, default=0)
+	parser.add_argument('--spilldir',help='Specify the directory for the spill file.  Default is $TMPDIR or /tmp.',type=str, default='')
+	parser.add_argument('--packed',help='Store each result as the combo chosen for each primary group, in just enough bits for the group, rather than as its items.  The results are the same, but take much less memory.',action='store_true',default=False)
+	parser.add_argument('--stream',help='Stream the results to this file as the search finds them, a line for each collection accepted ("A id value items...") and for each dropped later ("R id"), ending with "F n" once the n results are known.  See OSink.h.',type=str, default='')
+	parser.add_argument('--streamcmd',help='Likewise, but to the standard input of this shell command.  Ex. "gzip > res.gz".',type=str, default='')
+	parser.add_argument('--bestfirst',help='Use the best-first search.  This returns the top maxres collections in exactly descending order of value (ctol is ignored), paging through the ranking rather than searching for everything within ctol of the best.  maxres must be >0.',action='store_true',default=False)
 
 	c= parser.parse_args()
 
@@ -115,10 +134,61 @@ def ParseCommandLine(mp):
 	mp.smode= int(c.smode)
 	if (mp.smode<1 or mp.smode>4): KErrDie("Smode must be 1,2,3, or 4.")
 	
+	mp.nthreads= int(c.threads)
+	if (mp.nthreads<1): KErrDie("threads must be >=1")
+
 	mp.ofile= c.o
 	
 	mp.mctol= float(c.mctol)
 
+	mp.bmode= int(c.bmode)
+	if (mp.bmode<0 or mp.bmode>1): KErrDie("bmode must be 0 or 1")
+
+	mp.nbins= int(c.nbins)
+	if (mp.nbins<1): KErrDie("nbins must be >=1")
+
+	mp.gtol= float(c.gtol)
+
+	mp.timeout= float(c.timeout)
+	if (mp.timeout<0): KErrDie("timeout must be >=0")
+
+	mp.maxanal= int(c.maxanal)
+	if (mp.maxanal<0): KErrDie("maxanal must be >=0")
+
+	mp.plan= None
+	if (c.plan != ''):
+		tx= re.split(':',c.plan)
+		mp.plan= [list(),list()]
+		for i in tx:
+			if (len(i)<2 or (i[-1]!='v' and i[-1]!='c')): KErrDie("Each entry of the plan must be a group number followed by v or c")
+			mp.plan[0].append(int(i[:-1])-1)
+			mp.plan[1].append(1 if i[-1]=='c' else 0)
+
+	mp.autotune= int(c.autotune)
+	if (mp.autotune<0): KErrDie("autotune must be >=0")
+
+	mp.warmstart= int(c.warmstart)
+	if (mp.warmstart<0): KErrDie("warmstart must be >=0")
+
+	mp.combocache= int(c.combocache)
+	if (mp.combocache<0): KErrDie("combocache must be >=0")
+	mp.scalar= c.scalar
+	mp.spillmb= int(c.spillmb)
+	if (mp.spillmb<0): KErrDie("spillmb must be >=0")
+	mp.spilldir= c.spilldir
+	mp.packed= c.packed
+	mp.stream= c.stream
+	mp.streamcmd= c.streamcmd
+	if (mp.stream!='' and mp.streamcmd!=''): KErrDie("Only one of --stream and --streamcmd may be given")
+	mp.bestfirst= c.bestfirst
+	if (mp.bestfirst and mp.maxres<=0): KErrDie("maxres must be >0 for a best-first search")
+
+	mp.gntol= int(c.gntol)
+	if (mp.gntol<0): KErrDie("gntol must be >=0")
+
+	mp.maxcombos= int(c.maxcombos)
+	if (mp.maxcombos<0): KErrDie("maxcombos must be >=0")
+
 
 def VerifyFile(feats,items,vals,costs,prim,pfnn,sil):
 	ni= len(items)
@@ -258,9 +328,21 @@ def Main():
 		if (x[1]>nf): KErrDie("Feature specified in constraint exceeds maximum from input file!")
 
 	# Pass the parms and spec to C++
-	py_ccs_init_parms(mp.ctol,mp.itol,mp.ntol,mp.resnumb,mp.maxres,mp.smode)
+	py_ccs_init_parms(mp.ctol,mp.itol,mp.ntol,mp.resnumb,mp.maxres,mp.smode,mp.nthreads)
 	py_ccs_init_struct(nf,mp.primary-1,np.array(mp.pfn,dtype=np.int32),len(mp.pfn),ni,mp.maxcost,nc)
 	py_ccs_set_maxcosttol(mp.mctol)
+	py_ccs_set_bound_mode(mp.bmode,mp.nbins)
+	py_ccs_set_combo_cull(mp.gtol,mp.gntol)
+	py_ccs_set_combo_cap(mp.maxcombos)
+	py_ccs_set_limits(mp.timeout,mp.maxanal)
+	py_ccs_set_autotune(mp.autotune)
+	py_ccs_set_warmstart(mp.warmstart)
+	py_ccs_set_scalar(1 if mp.scalar else 0)
+	py_ccs_set_spill(mp.spillmb,mp.spilldir.encode())
+	py_ccs_set_packed(1 if mp.packed else 0)
+	py_ccs_set_combo_cache(mp.combocache)
+	if (mp.stream!='' and not py_ccs_set_sink_file(mp.stream.encode(),1)): KErrDie("Can't open stream file %s" % mp.stream)
+	if (mp.streamcmd!='' and not py_ccs_set_sink_pipe(mp.streamcmd.encode(),1)): KErrDie("Can't run stream command %s" % mp.streamcmd)
 
 	# Pass the features to C++
 	for i in range(0,len(feats)):
@@ -276,14 +358,36 @@ def Main():
 		foo= [x[1]-1,x[2]]
 		py_ccs_set_constraint(i,x[0],2,np.array(foo,dtype=np.int32))
 
+	# Pass the search plan (if any) to C++.  This needs the primary feature to be set up.
+	if (mp.plan is not None):
+		if (len(mp.plan[0])!=len(mp.pfn)): KErrDie("The plan must list each primary feature group exactly once")
+		order= np.array(mp.plan[0],dtype=np.int32)
+		bycost= np.zeros(len(mp.pfn),dtype=np.int32)
+		for i in range(0,len(order)):
+			if (order[i]<0 or order[i]>=len(mp.pfn)): KErrDie("The plan must list each primary feature group exactly once")
+			bycost[order[i]]= mp.plan[1][i]
+		if (py_ccs_set_plan(order,bycost)<1): KErrDie("The plan must list each primary feature group exactly once")
+
 	# Prepare for execution of the search algo
 	if (py_ccs_lock_and_load()<1): KErrDie("ERROR: lock and load failed")
 
-	# Pass signals to C++.  This allows Ctrl-C to interrupt
-	signal.signal(signal.SIGINT, signal.SIG_DFL)
+	# Let C++ catch Ctrl-C.  The search then stops cleanly and we keep what it found.  A second Ctrl-C kills us.
+	py_ccs_cancel_on_sigint(1)
 	
-	# Execute the search algo
-	if (py_ccs_execute(mp.debug)<1): KErrDie("ERROR: execute failed")
+	# Execute the search algo.  The best-first search returns results as we ask for them.
+	if (mp.bestfirst):
+		if (py_ccs_bf_start(mp.debug)<1): KErrDie("ERROR: best-first start failed")
+	else:
+		if (py_ccs_execute(mp.debug)<1): KErrDie("ERROR: execute failed")
+		why= py_ccs_stop_reason()
+		if (why>0):
+			reasons= ['','time limit reached','maxanal reached','interrupted']
+			KErr("Warning: search stopped early (%s) having covered %f of the state space.  Results are partial." % (reasons[why],py_ccs_coverage()))
+		if (mp.autotune>0 or mp.debug>0):
+			order= np.zeros(len(mp.pfn),dtype=np.int32)
+			bycost= np.zeros(len(mp.pfn),dtype=np.int32)
+			if (py_ccs_get_plan(order,bycost)>0): KErr("Search plan: --plan %s" % ':'.join(['%d%s' % (g+1,'c' if bycost[g] else 'v') for g in order]))
+	py_ccs_cancel_on_sigint(0)
 
 	# If no output requested, we are done!
 	if (mp.ofile == ''):
@@ -291,37 +395,31 @@ def Main():
 		sys.exit()
 
 	# Obtain the result count (and initialize result iterator) and collection length since we will need these
-	nr= py_ccs_prepres()
+	if (mp.bestfirst): nr= mp.maxres
+	else: nr= py_ccs_prepres()
 	clen= py_ccs_colllen()
 
 	# Pick a block size for retrieving results, and allocate the relevant arrays
 	ssize= 100000
 	if (ssize>nr): ssize= nr
 	resr= np.zeros([ssize,clen],dtype=np.uint32)
-	resrapi= (resr.__array_interface__['data'][0] + np.arange(resr.shape[0])*resr.strides[0]).astype(np.intp)
 	resm= np.zeros([ssize],dtype=np.float32)
+	if (mp.bestfirst): resrapi= (resr.__array_interface__['data'][0] + np.arange(resr.shape[0])*resr.strides[0]).astype(np.intp)
 
 	# Open the output file if need be
 	ofh= ''
 	if (mp.ofile != 'stdout'): ofh= open(mp.ofile,'w')
 
-	# Loop over the retrieval blocks
+	# Loop over the retrieval blocks.  Each collection's items are written in ascending order.
 	for i in range(0,nr,ssize):
-		nr1= py_ccs_getres(ssize,resrapi,resm)
-# e1[i]-s1[i])): KErrDie("Error retrieving results in range [%d,%d)" % (s1[i],e1[i]))
+		if (mp.bestfirst):
+			nr1= py_ccs_bf_next(min(ssize,nr-i),resrapi,resm)
+			if (nr1>0): resr[:nr1].sort(axis=1)
+		else: nr1= py_ccs_getres_flat(min(ssize,nr-i),resr,resm,1)
 
 		# Loop over the results within a retrieval block
 		for j in range(0,nr1):
-			ss= ""
-
-			# Loop over the items in a given result collection
-			vvv= list()
-			for k in range(0,clen):
-				vvv.append(resr[j][k])
-			vvv.sort()
-			for k in range(0,len(vvv)):
-				if (k>0): ss+= " "
-				ss+= str(vvv[k])
+			ss= " ".join([str(x) for x in resr[j]])
 
 			# Tack on the value
 			ss+= " "+str(resm[j])
@@ -20,7 +20,7 @@ def ccsapi():
 
 	global py_ccs_init_parms
 	py_ccs_init_parms= cm.kopt_init_parms
-	py_ccs_init_parms.argtypes = [ctypes.c_float,  ctypes.c_float, ctypes.c_int, ctypes.c_int, ctypes.c_long, ctypes.c_int]
+	py_ccs_init_parms.argtypes = [ctypes.c_float,  ctypes.c_float, ctypes.c_int, ctypes.c_int, ctypes.c_long, ctypes.c_int, ctypes.c_int]
 
 	global py_ccs_init_feature
 	py_ccs_init_feature= cm.kopt_init_feature
@@ -37,7 +37,77 @@ def ccsapi():
 	global py_ccs_set_maxcosttol
 	py_ccs_set_maxcosttol= cm.kopt_set_maxcosttol
 	py_ccs_set_maxcosttol.argtypes = [ctypes.c_float]
+
+	global py_ccs_set_bound_mode
+	py_ccs_set_bound_mode= cm.kopt_set_bound_mode
+	py_ccs_set_bound_mode.argtypes = [ctypes.c_int, ctypes.c_int]
+
+	global py_ccs_set_combo_cull
+	py_ccs_set_combo_cull= cm.kopt_set_combo_cull
+	py_ccs_set_combo_cull.argtypes = [ctypes.c_float, ctypes.c_int]
+
+	global py_ccs_set_combo_cap
+	py_ccs_set_combo_cap= cm.kopt_set_combo_cap
+	py_ccs_set_combo_cap.argtypes = [ctypes.c_long]
 	
+	global py_ccs_set_plan
+	py_ccs_set_plan= cm.kopt_set_plan
+	py_ccs_set_plan.restype= ctypes.c_int
+	py_ccs_set_plan.argtypes = [ctl.ndpointer(np.int32, flags='aligned, c_contiguous'), ctl.ndpointer(np.int32, flags='aligned, c_contiguous')]
+
+	global py_ccs_set_autotune
+	py_ccs_set_autotune= cm.kopt_set_autotune
+	py_ccs_set_autotune.argtypes = [ctypes.c_long]
+
+	global py_ccs_get_plan
+	py_ccs_get_plan= cm.kopt_get_plan
+	py_ccs_get_plan.restype= ctypes.c_int
+	py_ccs_get_plan.argtypes = [ctl.ndpointer(np.int32, flags='aligned, c_contiguous'), ctl.ndpointer(np.int32, flags='aligned, c_contiguous')]
+
+	global py_ccs_set_warmstart
+	py_ccs_set_warmstart= cm.kopt_set_warmstart
+	py_ccs_set_warmstart.argtypes = [ctypes.c_int]
+
+	global py_ccs_set_scalar
+	py_ccs_set_scalar= cm.kopt_set_scalar
+	py_ccs_set_scalar.argtypes = [ctypes.c_int]
+
+	global py_ccs_set_spill
+	py_ccs_set_spill= cm.kopt_set_spill
+	py_ccs_set_spill.argtypes = [ctypes.c_long,ctypes.c_char_p]
+
+	global py_ccs_set_packed
+	py_ccs_set_packed= cm.kopt_set_packed
+	py_ccs_set_packed.argtypes = [ctypes.c_int]
+
+	global py_ccs_set_sink_file
+	py_ccs_set_sink_file= cm.kopt_set_sink_file
+	py_ccs_set_sink_file.argtypes = [ctypes.c_char_p, ctypes.c_int]
+	py_ccs_set_sink_file.restype= ctypes.c_int
+
+	global py_ccs_set_sink_pipe
+	py_ccs_set_sink_pipe= cm.kopt_set_sink_pipe
+	py_ccs_set_sink_pipe.argtypes = [ctypes.c_char_p, ctypes.c_int]
+	py_ccs_set_sink_pipe.restype= ctypes.c_int
+
+	# The callback must be kept referenced (as a CCS_SINKFN) for as long as it's set
+	global CCS_SINKFN
+	CCS_SINKFN= ctypes.CFUNCTYPE(None, ctypes.c_int64, ctypes.POINTER(ctypes.c_uint), ctypes.c_int, ctypes.c_float)
+	global py_ccs_set_sink_callback
+	py_ccs_set_sink_callback= cm.kopt_set_sink_callback
+	py_ccs_set_sink_callback.argtypes = [CCS_SINKFN]
+
+	global py_ccs_set_combo_cache
+	py_ccs_set_combo_cache= cm.kopt_set_combo_cache
+	py_ccs_set_combo_cache.argtypes = [ctypes.c_long]
+
+	global py_ccs_get_combo_cache_stats
+	py_ccs_get_combo_cache_stats= cm.kopt_get_combo_cache_stats
+	py_ccs_get_combo_cache_stats.argtypes = [ctypes.POINTER(ctypes.c_long), ctypes.POINTER(ctypes.c_long), ctypes.POINTER(ctypes.c_long), ctypes.POINTER(ctypes.c_long), ctypes.POINTER(ctypes.c_long)]
+
+	global py_ccs_clear_combo_cache
+	py_ccs_clear_combo_cache= cm.kopt_clear_combo_cache
+
 	global py_ccs_lock_and_load
 	py_ccs_lock_and_load= cm.kopt_lock_and_load
 	py_ccs_lock_and_load.restype= ctypes.c_int
@@ -51,6 +121,25 @@ def ccsapi():
 	py_ccs_execute.restype= ctypes.c_int
 	py_ccs_execute.argtypes = [ctypes.c_int]
 
+	global py_ccs_set_limits
+	py_ccs_set_limits= cm.kopt_set_limits
+	py_ccs_set_limits.argtypes = [ctypes.c_double, ctypes.c_long]
+
+	global py_ccs_cancel
+	py_ccs_cancel= cm.kopt_cancel
+
+	global py_ccs_cancel_on_sigint
+	py_ccs_cancel_on_sigint= cm.kopt_cancel_on_sigint
+	py_ccs_cancel_on_sigint.argtypes = [ctypes.c_int]
+
+	global py_ccs_stop_reason
+	py_ccs_stop_reason= cm.kopt_stop_reason
+	py_ccs_stop_reason.restype= ctypes.c_int
+
+	global py_ccs_coverage
+	py_ccs_coverage= cm.kopt_coverage
+	py_ccs_coverage.restype= ctypes.c_double
+
 	global py_ccs_prepres
 	py_ccs_prepres= cm.kopt_prepres
 	py_ccs_prepres.restype= ctypes.c_int
@@ -64,9 +153,39 @@ def ccsapi():
 	py_ccs_getres.argtypes = [ctypes.c_int, ctl.ndpointer(np.intp, flags='aligned, c_contiguous'),ctl.ndpointer(np.float32, flags='aligned, c_contiguous')]
 	py_ccs_getres.restype= ctypes.c_int
 
+	global py_ccs_getres_flat
+	py_ccs_getres_flat= cm.kopt_getres_flat
+	py_ccs_getres_flat.argtypes = [ctypes.c_long, ctl.ndpointer(np.uint32, ndim=2, flags='aligned, c_contiguous, writeable'),ctl.ndpointer(np.float32, flags='aligned, c_contiguous, writeable'), ctypes.c_int]
+	py_ccs_getres_flat.restype= ctypes.c_long
+
+	global py_ccs_resview
+	py_ccs_resview= cm.kopt_resview
+	py_ccs_resview.argtypes = [ctypes.POINTER(ctypes.c_long), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int)]
+	py_ccs_resview.restype= ctypes.c_void_p
+
+	global py_ccs_bf_start
+	py_ccs_bf_start= cm.kopt_bf_start
+	py_ccs_bf_start.restype= ctypes.c_int
+	py_ccs_bf_start.argtypes = [ctypes.c_int]
+
+	global py_ccs_bf_next
+	py_ccs_bf_next= cm.kopt_bf_next
+	py_ccs_bf_next.argtypes = [ctypes.c_int, ctl.ndpointer(np.intp, flags='aligned, c_contiguous'),ctl.ndpointer(np.float32, flags='aligned, c_contiguous')]
+	py_ccs_bf_next.restype= ctypes.c_int
+
 	global py_ccs_release
 	py_ccs_release= cm.kopt_release
 
 	global py_ccs_reset
-	py_ccs_release= cm.kopt_reset
+	py_ccs_reset= cm.kopt_reset
 
+# The results as a numpy structured array (fields val and items) over the library's own storage, with no copy.  See kopt_resview in OAPI.h for how long it's good.  None if unavailable.
+def ccs_resview():
+	n= ctypes.c_long(0)
+	rsize= ctypes.c_int(0)
+	iw= ctypes.c_int(0)
+	p= py_ccs_resview(ctypes.byref(n),ctypes.byref(rsize),ctypes.byref(iw))
+	if (not p): return None
+	dt= np.dtype({'names': ['val','items'], 'formats': ['<f4',('<u%d' % iw.value,py_ccs_colllen())], 'offsets': [0,4], 'itemsize': rsize.value})
+	buf= (ctypes.c_char*(n.value*rsize.value)).from_address(p)
+	return np.frombuffer(buf,dtype=dt)
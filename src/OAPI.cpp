@@ -1,18 +1,21 @@
+#include <time.h>
 #include "OAPI.h"
 #include "OConfig.h"
 #include "OFeature.h"
 #include "OCFN.h"
 #include "OSearch.h"
+#include "OBestFirst.h"
 #include "OColl.h"
+#include "OCache.h"
 
 void kopt_init_struct_ts(OConfig &ac,int nf,int pf,int *pfn,int pfnn,int ni,float mc,int nc)
 {
 	ac.Init(nf,pf,pfn,pfnn,ni,mc,nc);
 }
 
-void kopt_init_parms_ts(OConfig &ac,float ctol,float itol,int ntol,int resnumb,long maxres,int smode)
+void kopt_init_parms_ts(OConfig &ac,float ctol,float itol,int ntol,int resnumb,long maxres,int smode,int nthreads)
 {
-	ac.InitParms(ctol,itol,ntol,resnumb,maxres,smode);
+	ac.InitParms(ctol,itol,ntol,resnumb,maxres,smode,nthreads);
 }
 
 void kopt_init_feature_ts(OConfig &ac,int fn,int ng,int ni,int ispart,int **f)
@@ -42,6 +45,21 @@ void kopt_set_maxcosttol_ts(OConfig &ac,float x)
 	ac.SetMaxCostTol(x);
 }
 
+void kopt_set_bound_mode_ts(OConfig &ac,int bmode,int nbins)
+{
+	ac.SetBoundMode(bmode,nbins);
+}
+
+void kopt_set_combo_cull_ts(OConfig &ac,float gtol,int gntol)
+{
+	ac.SetComboCull(gtol,gntol);
+}
+
+void kopt_set_combo_cap_ts(OConfig &ac,long maxcombos)
+{
+	ac.SetMaxCombos(maxcombos);
+}
+
 int kopt_lock_and_load_ts(OConfig &ac)
 {
 	if (!ac.IsSensible(false)) return 0;
@@ -55,7 +73,8 @@ double kopt_get_log_state_space_est_ts(OConfig &ac)
 	return ac.EstFullStateSpace();
 }
 
-int kopt_execute_ts(OConfig &ac,int debug)
+// The individual cull and its reporting, common to both kinds of search
+static void precull(OConfig &ac,int debug)
 {
 	if (debug & 1) ac.DumpConfig(stdout);
 	if (debug & 2) printf("Pre-cull state space est log_10(size): %lf\n",ac.EstFullStateSpace());
@@ -73,20 +92,170 @@ int kopt_execute_ts(OConfig &ac,int debug)
 	}
 	ac.InitConstraints();	// Pull in cull'ed features
 	if (debug & 2) printf("Post-cull state space est log_10(size): %lf\n",ac.EstFullStateSpace());
+}
+
+int kopt_execute_ts(OConfig &ac,int debug)
+{
+	precull(ac,debug);
+	int ng= ac.NumPrimaryGroups();
+	if (ng<=0) return 0;
+	int *order= new int [ng];
+	bool *bycost= new bool [ng];
 	OSearch s;
-	if (!s.Search(ac,ac.IsSearchByCost(),ac.IsGroupLowToHigh(),debug))
+	bool ok;
+	if (ac.AutoTuneNodes()>0&&OSearch::Tune(ac,ac.AutoTuneNodes(),order,bycost,debug)) ok= s.Prepare(ac,order,bycost,debug);
+	else ok= s.Prepare(ac,ac.PlanOrder(),ac.PlanByCost(),debug);
+	if (ok)
+	{
+		s.GetPlan(order,bycost);
+		ac.SetUsedPlan(order,bycost);
+		if (debug & 2)
+		{
+			printf("Search plan:");
+			for (int i=0;i<ng;++i) printf(" %d%c",order[i],bycost[order[i]]?'c':'v');
+			printf("\n");
+		}
+	}
+	delete [] order;
+	delete [] bycost;
+	if (!ok)
+	{
+		printf("ERROR: OSearch Search failed\n");
+		return 0;
+	}
+	s.WarmStart(ac.WarmStarts());
+	struct timespec t0,t1;
+	clock_gettime(CLOCK_MONOTONIC,&t0);
+	int rc= s.Continue(0);
+	ac.ClearCancel();
+	if (rc<0||(rc==0&&s.StopReason()==OSearch::StopNone()))
 	{
 		printf("ERROR: OSearch Search failed\n");
 		return 0;
 	}
+	clock_gettime(CLOCK_MONOTONIC,&t1);
+	ac.SetSearchStatus(s.StopReason(),s.Coverage());
 	if (debug & 2)
 	{
 		for (int i=0;i<s.NumCounters();++i)
 			printf("%s : %ld\n",s.NameOfCnt(i).c_str(),s.ReadCounter(i));
+		double secs= (t1.tv_sec-t0.tv_sec)+1e-9*(t1.tv_nsec-t0.tv_nsec);
+		printf("Search: %ld nodes in %.3fs (%.0f nodes/sec)\n",s.NumNodes(),secs,(secs>0)?(s.NumNodes()/secs):0.0);
+		if (ac.AccessMM()->GetNumDups()>0) printf("Duplicate collections rejected: %ld\n",ac.AccessMM()->GetNumDups());
+		if (s.StopReason()!=OSearch::StopNone()) printf("Search stopped early (reason %d) having covered %.6f of the state space\n",s.StopReason(),s.Coverage());
 	}
 	return 1;
 }
 
+void kopt_set_limits_ts(OConfig &ac,double secs,long maxanal)
+{
+	ac.SetLimits(secs,maxanal);
+}
+
+void kopt_cancel_ts(OConfig &ac)
+{
+	ac.Cancel();
+}
+
+int kopt_stop_reason_ts(OConfig &ac)
+{
+	return ac.StopReason();
+}
+
+double kopt_coverage_ts(OConfig &ac)
+{
+	return ac.Coverage();
+}
+
+int kopt_set_plan_ts(OConfig &ac,int *order,int *bycost)
+{
+	return ac.SetSearchPlan(order,bycost)?1:0;
+}
+
+void kopt_set_autotune_ts(OConfig &ac,long probenodes)
+{
+	ac.SetAutoTune(probenodes);
+}
+
+int kopt_get_plan_ts(OConfig &ac,int *order,int *bycost)
+{
+	return ac.GetUsedPlan(order,bycost);
+}
+
+void kopt_set_warmstart_ts(OConfig &ac,int nseed)
+{
+	ac.SetWarmStart(nseed);
+}
+
+void kopt_set_scalar_ts(OConfig &ac,int scalar)
+{
+	ac.SetScalarKernel(scalar!=0);
+}
+
+void kopt_set_spill_ts(OConfig &ac,long rammb,const char *dir)
+{
+	ac.SetSpill(rammb,dir);
+}
+
+void kopt_set_packed_ts(OConfig &ac,int packed)
+{
+	ac.SetPackedResults(packed!=0);
+}
+
+int kopt_set_sink_file_ts(OConfig &ac,const char *path,int text)
+{
+	if (!path||!*path)
+	{
+		ac.SetSink(NULL);
+		return 1;
+	}
+	OCollStreamSink *s= new OCollStreamSink;
+	if (!s->OpenFile(path,text!=0))
+	{
+		delete s;
+		return 0;
+	}
+	ac.SetSink(s);
+	return 1;
+}
+
+int kopt_set_sink_pipe_ts(OConfig &ac,const char *cmd,int text)
+{
+	if (!cmd||!*cmd)
+	{
+		ac.SetSink(NULL);
+		return 1;
+	}
+	OCollStreamSink *s= new OCollStreamSink;
+	if (!s->OpenPipe(cmd,text!=0))
+	{
+		delete s;
+		return 0;
+	}
+	ac.SetSink(s);
+	return 1;
+}
+
+void kopt_set_sink_callback_ts(OConfig &ac,OCollSinkFn fn)
+{
+	ac.SetSink(fn?(new OCollCallbackSink(fn)):NULL);
+}
+
+void kopt_set_combo_cache_ts(long maxcombos)
+{
+	OComboCache::Global().SetLimit(maxcombos);
+}
+
+void kopt_get_combo_cache_stats_ts(long *hits,long *reuses,long *misses,long *entries,long *combos)
+{
+	OComboCache::Global().Stats(hits,reuses,misses,entries,combos);
+}
+
+void kopt_clear_combo_cache_ts(void)
+{
+	OComboCache::Global().Clear();
+}
+
 int kopt_colllen_ts(OConfig &ac)
 {
 	return ac.CollectionSize();
@@ -94,7 +263,7 @@ int kopt_colllen_ts(OConfig &ac)
 
 int kopt_prepres_ts(OConfig &ac)
 {
-	ac.AccessMM()->InitResIter();
+	ac.AccessMM()->InitResIter(ac.NumThreads());
 	return ac.AccessMM()->GetNumRec();
 }
 
@@ -103,6 +272,39 @@ int kopt_getres_ts(OConfig &ac,int n,unsigned int **r,float *m)
 	return ac.AccessMM()->GetRes(n,r,m);
 }
 
+long kopt_getres_flat_ts(OConfig &ac,long n,unsigned int *r,float *m,int sorted)
+{
+	return ac.AccessMM()->GetResFlat(n,r,m,sorted!=0);
+}
+
+const void *kopt_resview_ts(OConfig &ac,long *n,int *rsize,int *iw)
+{
+	if (n) *n= 0;
+	if (iw) *iw= ac.AccessMM()->ItemWidth();
+	return ac.AccessMM()->ResView(n,rsize);
+}
+
+int kopt_bf_start_ts(OConfig &ac,int debug)
+{
+	precull(ac,debug);
+	OBestFirst *b= new OBestFirst;
+	if (!b->Start(ac,debug))
+	{
+		delete b;
+		printf("ERROR: OBestFirst Start failed\n");
+		return 0;
+	}
+	ac.SetBestFirst(b);
+	return 1;
+}
+
+int kopt_bf_next_ts(OConfig &ac,int n,unsigned int **r,float *m)
+{
+	OBestFirst *b= ac.AccessBestFirst();
+	if (!b) return -1;
+	return b->Next(n,r,m);
+}
+
 void kopt_release_ts(OConfig &ac)
 {
 	ac.Clear();
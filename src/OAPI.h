@@ -8,6 +8,7 @@ To use them, just instantiate an OConfig object, and then pass it to the routine
 */
 
 #include "OConfig.h"
+#include "OSink.h"
 
 /* 
 
@@ -39,6 +40,7 @@ Initialize the relevant global search parameters
 		1+= cull less
 	resnumb: Block allocation size.  Generally this doesn't affect the user much unless very large numbers of collections are being analyzed and discarded.  
 	maxres: Maximum number of collections to allow.  If we get more, then a garbage collection is triggered. 
+	nthreads: Number of search threads.  1 is the ordinary serial search.  More splits the search tree into tasks (by the combos chosen for the first few groups searched) which are run on a work-stealing pool.  All threads prune against a shared threshold, so a good collection found by one immediately tightens pruning in the others.  The results are the same as a serial run's.  Each thread keeps up to maxres results of its own until they are merged at the end.
 	smode: Search order.  There are 2 search decisions specified here.  The order of primary feature groups scanned by combinatoric number of selections possible can be low to high or high to low, and the order of selections in each group can be increasing by cost or decreasing by value.  
 		1=  Fewest-to-most combinations / Decreasing Value
 		2=  Most-to-fewest combinations / Decreasing Value
@@ -49,11 +51,12 @@ Initialize the relevant global search parameters
 		ntol, itol	govern initial individual cull
 		ctol, maxres (and somewhat resnumb)	govern number of collections kept and how the list is managed
 		smode		governs search order
+		nthreads	governs parallelism
 
 	Generally, ntol=0, itol= low (ex. 0.1) is good unless there is a flex group.  In that case, increase to ntol=1 and/or itol slightly higher.
 	 
 */
-void kopt_init_parms_ts(OConfig &ac,float ctol,float itol,int ntol,int resnumb,long maxres,int smode);
+void kopt_init_parms_ts(OConfig &ac,float ctol,float itol,int ntol,int resnumb,long maxres,int smode,int nthreads);
 
 /* 
 
@@ -101,6 +104,101 @@ void kopt_set_maxcosttol_ts(OConfig &ac,float x);
 
 /*
 
+Set the bound used to prune the search.
+	bmode= 0: (default) classic bound.  A branch is pruned if even the best values (or lowest costs) of all the remaining groups, taken separately, can't make up the difference.  This ignores how much of the cost budget is left.
+	bmode= 1: budget tables.  Before the search we tabulate the best value obtainable from each group onward for every amount of remaining cost (in nbins equal bins from 0 to maxcost), along with its dual (the least cost needed to reach a given value).  A branch is pruned if the remaining budget can't buy enough value.  This is much tighter when the budget binds, at the price of a small table per group.
+	nbins= number of cost bins for bmode 1.  More is tighter but the tables take longer to build.  Default is 1000.
+
+The classic tests are always performed.  The number of extra nodes pruned by the tables is reported in the PrunedBudget counter.
+*/
+void kopt_set_bound_mode_ts(OConfig &ac,int bmode,int nbins);
+
+/*
+
+Set the combo cull.  This is the analogue of the individual item cull (see itol, ntol above), but applied to the combos of items picked from each primary group.  It is performed when the combos are built, before searching.
+	gtol= combo tolerance.  A combo is culled if there are at least 1+gntol other combos in its group with lower or equal cost and value more than gtol% higher.  <0 (the default) disables the combo cull.
+	gntol= number of extra combos to require.  Default is 0.
+
+Like the individual cull, this can lose collections if the better combos all run afoul of the constraints or share items with other groups, which is what gntol guards against.  Separately from this, combos which can't fit under maxcost even with the cheapest picks from all the other groups are always dropped, since the search never could use them.  With debug flag 2, the number of combos removed from each group is reported.
+*/
+void kopt_set_combo_cull_ts(OConfig &ac,float gtol,int gntol);
+
+/*
+
+Cap the number of combos kept for each primary group.  The combos of a group are generated in the order it is scanned (best value or lowest cost first) rather than all at once, so only those kept ever are held.  This matters for a group with many items and several picks (or one open to the whole slate), whose combos could number in the billions.  Sorted by cost, generation stops by itself once the combos no longer fit under maxcost.  Sorted by value it can't, and maxcombos stops it instead.
+	maxcombos= the most combos to keep per group.  0 (the default) means no limit.
+
+Like the combo cull, this can lose collections: those which need a combo past the cap.  With debug flag 2, the groups which were capped are reported.
+*/
+void kopt_set_combo_cap_ts(OConfig &ac,long maxcombos);
+
+/*
+
+Set the search plan.  This generalizes smode, which fixes one of two group orders and one scan direction for all groups.
+	order= array (length = number of primary groups) giving the primary group to search at each level, first to last.  NULL to order the groups as smode says.
+	bycost= array (length = number of primary groups) saying, for each primary group, whether to scan its combos by increasing cost (nonzero) or decreasing value (0).  NULL to follow smode.
+Returns 0 (and leaves the plan alone) if order isn't a permutation of the primary groups.  Must be called after the primary feature has been set up with kopt_init_feature.
+
+kopt_set_autotune asks kopt_execute to choose the plan itself.  It runs a short serial probe search of probenodes combos for each of a set of candidate plans (the one configured, which wins ties, and the fewest-to-most and most-to-fewest combos orders with each group scanned by value, by cost, or one way except for the last level), and runs the real search with whichever covers the most of the state space per combo visited.  0 (the default) turns this off.
+
+kopt_get_plan fills order and bycost (as above) with the plan the last search used, and returns the number of primary groups (0 if there's been no search).  A plan chosen by the auto-tuner can be passed straight back to kopt_set_plan for the next slate with the same structure.
+*/
+int kopt_set_plan_ts(OConfig &ac,int *order,int *bycost);
+void kopt_set_autotune_ts(OConfig &ac,long probenodes);
+int kopt_get_plan_ts(OConfig &ac,int *order,int *bycost);
+
+/*
+
+Set the warm start.  Before searching, kopt_execute tries to find nseed good collections quickly (each begins with a different choice for the first group searched, fills the other groups greedily by value within the budget, and then swaps one group's picks at a time while that improves the value) and adds those which satisfy the constraints to the results.  The search then prunes by value from the start rather than only once it has found its first collection.  The search finds the seeds again, but they are only returned once.  0 (the default) turns this off.
+
+With debug flag 2, the number seeded, the best value and the threshold they gave are reported, and the PrunedSeed counter gives the number of nodes pruned by value while the threshold was still the one the warm start set.
+*/
+void kopt_set_warmstart_ts(OConfig &ac,int nseed);
+
+/*
+
+Force the plain scan loop.  The search skips runs of combos which fail its cost or value test with a block scan, vectorized with the widest instructions the CPU supports (AVX2 or SSE2, chosen at runtime).  It gives exactly the same results as the plain loop, which scalar nonzero forces instead, to check one against the other.  0 (the default) uses the vectorized scan.  With debug flag 2, the scan in use is reported.
+*/
+void kopt_set_scalar_ts(OConfig &ac,int scalar);
+
+/*
+
+Spill the results to disk.  With maxres 0 (no limit) and a wide ctol there can be more results than fit in memory.  Once they take more than rammb MB, they are sorted and written out as a run to a scratch file in dir (NULL or "" for $TMPDIR or /tmp), which is mapped into memory and unlinked at once, so the OS pages it out as it needs and it vanishes with the results.  The memory is then reused for the next run.  kopt_prepres and kopt_getres merge the runs, so the results come back just as they would without spilling.  In a parallel search, each thread gets an equal share of rammb.  0 (the default) never spills.  Has no effect when maxres is set.
+*/
+void kopt_set_spill_ts(OConfig &ac,long rammb,const char *dir);
+
+/*
+
+Pack the results.  A collection is a choice of combo for each primary group, so rather than its items (1 to 4 bytes each, depending on the number of items) we can store the index of each combo among its group's, in just enough bits for the number of combos the group has.  The items are looked up again by kopt_getres.  This takes much less memory for large collections, so more results fit (or fewer spill).  Nonzero packs, 0 (the default) doesn't.  The results are the same either way.  With debug flag 2, the size of a packed collection is reported.
+*/
+void kopt_set_packed_ts(OConfig &ac,int packed);
+
+/*
+
+Stream the results as the search finds them, so they can be consumed before it's done.  Each collection is passed on as it's accepted, with an id, and each id again if it's later dropped: when the threshold rises past it, when it's displaced once maxres are held, or (in a parallel search) when it loses out as the threads' results are merged.  Once kopt_prepres is called, the collections accepted and not dropped are exactly the results, and a final event says how many there are.  kopt_reset sends a clear event, after which ids start over.  They come in no particular order.  See OSink.h for the formats.
+	kopt_set_sink_file writes them to the file path, and kopt_set_sink_pipe to the standard input of the shell command cmd.  Binary unless text is nonzero.  Return 0 if the file or command can't be opened.  While a pipe is open SIGPIPE is ignored for the whole process, so a command which quits early ends the stream rather than the program.  Its previous disposition is restored when the pipe is closed (by another kopt_set_sink call or kopt_release).
+	kopt_set_sink_callback calls fn (serially, though in a parallel search from the search threads) with the id, items, collection length and value of each accepted collection, and with the id, NULL, 0 and 0 for each dropped one.  The final event has the number of results as the id and collection length -1, the clear event id -2.
+NULL (or "") stops streaming.  Must be called after kopt_init_struct, and the sink is closed by kopt_release.  Has no effect on what's returned by kopt_getres.
+*/
+int kopt_set_sink_file_ts(OConfig &ac,const char *path,int text);
+int kopt_set_sink_pipe_ts(OConfig &ac,const char *cmd,int text);
+void kopt_set_sink_callback_ts(OConfig &ac,OCollSinkFn fn);
+
+/*
+
+The combo cache.  Unlike the settings above, this is shared by every OConfig in the process.  The combos of each primary group depend only on its items and the number picked, so a slate which is searched again (say with new values or costs) has the same ones, and only their sums and order need recomputing.  If the values and costs are the same too (say only maxcost changed), even the order is reused.  The cache keeps them across searches for the groups scanned by value, and drops the least recently used once it holds more than the limit in all.  A group with more combos than the limit isn't cached, nor is one scanned by cost (its combos are generated cheapest first, stopping once they no longer fit, which is faster still).
+	maxcombos= the most combos to hold in all.  0 disables and empties the cache.  The default is 2097152.
+
+kopt_get_combo_cache_stats fills in (each if not NULL) the number of lookups since the cache last was cleared which found the combos but had to sort them again, which found them already sorted, and which didn't find them, and the number of entries and combos it holds.  With debug flag 2, these are reported after building the combos.
+
+kopt_clear_combo_cache empties the cache and zeroes the stats.
+*/
+void kopt_set_combo_cache_ts(long maxcombos);
+void kopt_get_combo_cache_stats_ts(long *hits,long *reuses,long *misses,long *entries,long *combos);
+void kopt_clear_combo_cache_ts(void);
+
+/*
+
 Post-initialize preparation for calculation.  
 This must be called prior to any searches.
 Verifies we have everything and generates various info that will be needed for the calculation.  Returns 0 on failure.
@@ -135,6 +233,21 @@ If displaystats>0, then will dump various pruning info along the way.
 */
 int kopt_execute_ts(OConfig &ac,int debug);
 
+/*
+
+Limits on the search.  When one is reached, kopt_execute returns early (and successfully) with whatever collections it has found so far.  
+	secs= time limit for the search in seconds.  0 (the default) means none.
+	maxanal= maximum number of collections to analyze (i.e. which survive pruning).  0 (the default) means none.  This is checked periodically, so may be overshot slightly.
+
+kopt_cancel stops a search in progress the same way.  It may be called from another thread or from a signal handler.  If called before kopt_execute, the next search stops at once.
+
+kopt_stop_reason reports why the last search stopped early: 0 if it didn't, 1 if the time limit expired, 2 if it hit maxanal, 3 if it was cancelled.  kopt_coverage reports the fraction of the (post-cull) state space the last search covered, whether by pruning or by analyzing.  It is 1 if the search completed.
+*/
+void kopt_set_limits_ts(OConfig &ac,double secs,long maxanal);
+void kopt_cancel_ts(OConfig &ac);
+int kopt_stop_reason_ts(OConfig &ac);
+double kopt_coverage_ts(OConfig &ac);
+
 /* 
 
 Prep to begin obtaining results and get the number of collections the search kept.  
@@ -166,6 +279,28 @@ Sequential calls will get sequential portions of n results (from top value down)
 */
 int kopt_getres_ts(OConfig &ac,int n,unsigned int **r,float *m);
 
+/*
+
+Read the results in bulk.  kopt_getres_flat is kopt_getres (see there), but r is a single contiguous n x cl array (C order, so numpy's default) rather than an array of row pointers.  If sorted is nonzero, each row's items come back in ascending order, rather than in their slots' order.  Returns the number of rows populated, -1 on error, 0 if none left.  It picks up from where either left off.
+
+kopt_resview returns the results where they're stored, for reading in place without a copy.  Call after kopt_prepres.  They're first rearranged into result order, so this is the address of *n records of *rsize bytes each: the value (a float32) and then cl item numbers, each an unsigned integer of *iw bytes (1, 2 or 4, depending on the number of items).  In numpy terms, a structured array of dtype [('val','<f4'),('items','<u%d' % iw,cl)] with itemsize rsize.  Fields aren't aligned.  The memory belongs to the library, and is good until the next kopt_execute, kopt_reset or kopt_release.  Also restarts kopt_getres.  Returns NULL (and *n 0) if the results are packed or have spilled (see kopt_set_packed and kopt_set_spill), or if there are none.
+*/
+long kopt_getres_flat_ts(OConfig &ac,long n,unsigned int *r,float *m,int sorted);
+const void *kopt_resview_ts(OConfig &ac,long *n,int *rsize,int *iw);
+
+/*
+
+Best-first search.  This is an alternative to kopt_execute/kopt_prepres/kopt_getres which returns the collections in exactly descending order of value, as many as are asked for, without fixing ctol and maxres in advance (they are ignored).  
+
+kopt_bf_start performs the same individual cull as kopt_execute and sets up a result cursor.  It is called in place of kopt_execute, and returns 0 on failure.  debug is as for kopt_execute.
+
+kopt_bf_next returns the next n collections in the ranking, exactly as kopt_getres would (see there for the arrays).  It may be called repeatedly, each call picking up where the last left off, to page as deep as desired.  Returns the number of collections populated, 0 if none are left, -1 on error (including if kopt_bf_start hasn't been called).
+
+The work done grows with the depth paged to, and the cursor's memory with the number of partial collections it has pending, so this is best suited to the top few thousand or so.  kopt_reset and kopt_release discard the cursor.
+*/
+int kopt_bf_start_ts(OConfig &ac,int debug);
+int kopt_bf_next_ts(OConfig &ac,int n,unsigned int **r,float *m);
+
 /* 
 
 Deallocate and release all memory used in the calculation.  After this, the results will be unavailable for future use.  HOWEVER, will not affect any of the arrays passed via kopt_getres calls, only the internal storage used on the C/C++ end.
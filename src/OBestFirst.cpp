@@ -0,0 +1,144 @@
+#include <string.h>
+#include <math.h>
+#include "OConfig.h"
+#include "OBestFirst.h"
+
+OBestFirst::OBestFirst(void) : OSearch(), _q(), _n(), _free(), _npop(0), _nemit(0) {}
+
+bool OBestFirst::Start(const OConfig &x,int debug)
+{
+	if (!Prepare(x,false,x.IsGroupLowToHigh(),debug)) return false;
+	OSrchMtxCtl mtx(this);
+	long i= firstfit(0,0,_oc->MaxCost());
+	if (i<_rp[0]->Combos()) newnode(0,i,-1,_oc->MaxCost(),0.0);
+	return true;
+}
+
+// The cost test is the search's own, so the range index takes us straight past the combos it would reject.
+long OBestFirst::firstfit(int g,long i,float rcost) const
+{
+	return _rp[g]->_gc.NextCheapEnough(i,_rp[g]->_rlcost,rcost+_oc->MaxCostTol());
+}
+
+// The value is summed exactly as the search sums it, so a complete collection's key is its value.  Otherwise the key is the classic bound, which is no less for our later siblings since their combos are worth no more.  We pad it by a hair so that rounding in the bound can't let a collection out ahead of a slightly better one still beneath it.
+long OBestFirst::newnode(int g,long i,long p,float rcost,float val)
+{
+	long x;
+	if (!_free.empty())
+	{
+		x= _free.back();
+		_free.pop_back();
+	}
+	else
+	{
+		x= _n.size();
+		_n.push_back(OBFNode());
+	}
+	OBFNode &nd= _n[x];
+	nd._g= g;
+	nd._i= i;
+	nd._p= p;
+	nd._ref= 0;
+	nd._rcost= rcost;
+	nd._val= val;
+	nd._key= val+_rp[g]->_gc.Val(i);
+	if (g<_ng-1)
+	{
+		nd._key+= _rp[g]->_rbval;
+		nd._key+= BNDEPSILON*(1+fabs(nd._key));
+	}
+	if (p>=0) _n[p]._ref++;
+	_q.push(BFQENT(nd._key,x));
+	return x;
+}
+
+void OBestFirst::release(long x)
+{
+	while (x>=0&&_n[x]._ref==0)
+	{
+		long p= _n[x]._p;
+		_free.push_back(x);
+		if (p<0) break;
+		_n[p]._ref--;
+		x= p;
+	}
+}
+
+void OBestFirst::fillused(int g,long p)
+{
+	uint64_t *u= _st[0]._used+(long)g*_nwd;
+	memset(u,0,sizeof(uint64_t)*_nwd);
+	for (;p>=0;p= _n[p]._p)
+	{
+		_st[0]._stk[_n[p]._g]._i= _n[p]._i;
+		const OSGrpRec *gr= _rp[_n[p]._g];
+		for (int k=0;k<gr->_np;++k)
+		{
+			int it= gr->Item(_n[p]._i,k);
+			u[it>>6]|= 1ULL<<(it&63);
+		}
+	}
+}
+
+int OBestFirst::Next(int n,unsigned int **r,float *m)
+{
+	OSrchMtxCtl mtx(this);
+	if (n<=0) return -1;
+	if (!r||!m) return -1;
+	if (!_st) return -1;
+	float mtol= _oc->MaxCostTol();
+	int *tcol= _st[0]._tcol;
+	int k= 0;
+	while (k<n&&!_q.empty())
+	{
+		long x= _q.top().second;
+		_q.pop();
+		++_npop;
+		int g= _n[x]._g;
+		long i= _n[x]._i;
+		long p= _n[x]._p;
+		float rcost= _n[x]._rcost;
+		float val= _n[x]._val;
+		OSGrpRec *gr= _rp[g];
+		float cc= gr->_gc.Cost(i);
+		float cv= gr->_gc.Val(i);
+
+		// Our next sibling which can fit
+		long j= firstfit(g,i+1,rcost);
+		if (j<gr->Combos()) newnode(g,j,p,rcost,val);
+
+		// Can we lead anywhere?
+		bool ok= !(cc+gr->_rlcost>rcost+mtol);
+		if (ok&&gr->_chkdup)
+		{
+			fillused(g,p);
+			ok= !conflicts(_st[0],g,i);
+			if (ok&&gr->_nsym) ok= !noncanonical(_st[0]._stk,g,i);
+		}
+		if (ok&&_sbt&&g<_ng-1) ok= !bndprune(g,cc,cv,rcost,val,BadVal());
+		if (ok&&g<_ng-1)
+		{
+			long c= firstfit(g+1,0,rcost-cc);
+			if (c<_rp[g+1]->Combos()) newnode(g+1,c,x,rcost-cc,val+cv);
+		}
+		else if (ok)
+		{
+			// A complete collection, and the best left
+			for (long y=x;y>=0;y= _n[y]._p)
+			{
+				const OSGrpRec *yr= _rp[_n[y]._g];
+				for (int q=0;q<yr->_np;++q)
+					tcol[_tloc[_n[y]._g]+q]= yr->Item(_n[y]._i,q);
+			}
+			if (_oc->TestConstraints(tcol)<0)
+			{
+				for (int q=0;q<_cs;++q) r[k][q]= tcol[q];
+				m[k]= val+cv;
+				++k;
+				++_nemit;
+			}
+		}
+		release(x);
+	}
+	return k;
+}
@@ -0,0 +1,51 @@
+#ifndef OBESTFIRSTDEFFLAG
+#define OBESTFIRSTDEFFLAG
+
+#include <vector>
+#include <queue>
+#include "OSearch.h"
+
+// A partial assignment: combo _i of level _g beneath the assignment _p of the levels above.
+struct OBFNode
+{
+	float _key;		// Upper bound on the value of any collection reachable from here (including via our later siblings)
+	float _val;		// Value of the levels above ours
+	float _rcost;		// Cost still available on entering our level (i.e. before our combo)
+	int _g;			// Level
+	long _i;		// Combo
+	long _p;		// Parent node.  -1 at level 0.
+	int _ref;		// Number of live nodes whose parent we are.  We're freed once we've been popped and this is 0.
+};
+
+/* Best-first enumeration of the collections in exactly descending order of value.
+
+Rather than a depth-first search over a threshold fixed in advance, we keep a priority queue of partial assignments ordered by an upper bound on what they can lead to.  Each node stands for a choice of combo at each level down to its own.  When popped, it pushes its next sibling (the next combo of its level, which is no more valuable since combos are sorted by value) and, if the remaining groups still can fit, its first child.  Every assignment is reached exactly once, and a node's bound covers both its own subtree and those of its later siblings, so when a complete collection reaches the top of the queue nothing left can beat it.
+
+This is a cursor.  Next() may be called repeatedly, each time paging further down the ranking from where the last call left off.  ctol and maxres play no part.  The same precomputation (group records, dup masks, budget tables and combo culls) as the ordinary search is used, though the combos always are scanned by value.
+*/
+class OBestFirst : public OSearch
+{
+private:
+	OBestFirst(const OBestFirst &x) {}
+protected:
+	typedef std::pair<float,long> BFQENT;
+	std::priority_queue<BFQENT> _q;		// Nodes waiting to be expanded, by key
+	std::vector<OBFNode> _n;	// Node storage
+	std::vector<long> _free;	// Free slots in _n
+	long _npop;			// Nodes popped so far
+	long _nemit;			// Collections returned so far
+
+	long newnode(int g,long i,long p,float rcost,float val);	// Create and queue node for combo i of level g, given the cost available and value so far.
+	long firstfit(int g,long i,float rcost) const;	// First combo of level g from i on which can fit the cost available
+	void release(long x);		// Done with node x (and any parents left childless)
+	void fillused(int g,long p);	// Set the used items for level g, and the combos chosen above it, from the ancestry p
+public:
+	OBestFirst(void);
+	bool Start(const OConfig &x,int debug);	// Precompute everything and queue the root.  grouplowtohigh is taken from x.
+	int Next(int n,unsigned int **r,float *m);	// Return (up to) the next n collections, as OCollMM::GetRes() would.  0 when there are no more, -1 on error.
+	long NumPopped(void) const { return _npop; }
+	long NumReturned(void) const { return _nemit; }
+	long QueueSize(void) const { return _q.size(); }
+};
+
+#endif
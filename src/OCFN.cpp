@@ -163,15 +163,13 @@ void OCFNMinGroups::reset(void)
 
 //////////  OFCNMaxItems
 
-OCFNMaxItems::OCFNMaxItems(const OConfig *src,int fnum,int mcnt) : OCFNGrpCntBase(src,fnum), _cnt(mcnt), _x(NULL) {}
+OCFNMaxItems::OCFNMaxItems(const OConfig *src,int fnum,int mcnt) : OCFNGrpCntBase(src,fnum), _cnt(mcnt) {}
 
 bool OCFNMaxItems::init(void)
 {
 	if (!this->OCFNGrpCntBase::init()) return false;
 	if (_cnt<=0) return false;	// If 0 never will pass!
 	if (_ng<=0) return false;
-	if (_x) return false;
-	_x= new int [_ng];
 	return true;
 }
 
@@ -179,7 +177,6 @@ bool OCFNMaxItems::isvalid(void) const
 {
 	if (!this->OCFNGrpCntBase::isvalid()) return false;
 	if (_cnt<=0) return false;	// If 0 never will pass!
-	if (!_x) return false;
 	return true;
 }
 
@@ -187,14 +184,20 @@ bool OCFNMaxItems::test(const int *c) const
 {
 	if (!c) return false;
 	if (!_l) return false;
-	memset(_x,0,_ng*sizeof(int));
+
+	// The parallel search calls us from several threads at once, so we keep no scratch of our own.  Small features count on the stack.
+	int buf[256];
+	int *x= (_ng<=256)?buf:(new int [_ng]);
+	memset(x,0,_ng*sizeof(int));
+	bool rc= true;
 	for (int i=0;i<_clen;++i)
 	{
-		if (c[i]<0||c[i]>=_ni) return false;
-		_x[_l[c[i]]]++;
-		if (_x[_l[c[i]]]>_cnt) return false;
+		if (c[i]<0||c[i]>=_ni) { rc= false; break; }
+		x[_l[c[i]]]++;
+		if (x[_l[c[i]]]>_cnt) { rc= false; break; }
 	}
-	return true;
+	if (x!=buf) delete [] x;
+	return rc;
 }
 
 std::string OCFNMaxItems::desc(void) const
@@ -207,6 +210,134 @@ std::string OCFNMaxItems::desc(void) const
 void OCFNMaxItems::reset(void)
 {
 	this->OCFNGrpCntBase::reset();
-	if (_x) delete [] _x;
-	_x= NULL;
+}
+
+//////////  OCFNFused
+
+bool OCFNFused::Build(const OConfig *src,const OCFN *const *cfn,int n)
+{
+	_cfn= cfn;
+	_ncfn= n;
+	_kind.assign(n,-1);
+	_col.assign(n,-1);
+	_cnt.assign(n,0);
+	_nk= 0;
+	_tot= 0;
+	_nfused= 0;
+	if (!src||!cfn) return false;
+	_clen= src->CollectionSize();
+	_ni= src->NumItems();
+	if (_clen<=0||_clen>255||_ni<=0) return false;	// Counts must fit a byte
+	int fn[MaxCols];
+	const int *gl[MaxCols];
+	for (int i=0;i<n;++i)
+	{
+		const OCFNGrpCntBase *b= dynamic_cast<const OCFNGrpCntBase *>(cfn[i]);
+		if (!b||!b->GroupOf()||b->NumGroups()<=0||b->NumGroups()>MaxGroups) continue;
+		int t;
+		if (const OCFNMinGroups *x= dynamic_cast<const OCFNMinGroups *>(b))
+		{
+			t= OCFNMinGroups::SType();
+			_cnt[i]= x->Count();
+		}
+		else if (const OCFNMaxItems *x= dynamic_cast<const OCFNMaxItems *>(b))
+		{
+			t= OCFNMaxItems::SType();
+			_cnt[i]= x->Count();
+		}
+		else continue;
+		int k= 0;
+		while (k<_nk&&fn[k]!=b->FeatureNum()) ++k;
+		if (k==_nk)
+		{
+			if (_nk==MaxCols) continue;
+			fn[k]= b->FeatureNum();
+			gl[k]= b->GroupOf();
+			_ng[k]= b->NumGroups();
+			_wcnt[k]= (_ng[k]>64);
+			_wmask[k]= false;
+			++_nk;
+		}
+		if (t==OCFNMaxItems::SType()) _wcnt[k]= true;
+		else _wmask[k]= true;
+		_kind[i]= t;
+		_col[i]= k;
+		++_nfused;
+	}
+	if (_nfused==0) return false;
+	for (int k=0;k<_nk;++k)
+	{
+		_off[k]= _tot;
+		if (_wcnt[k]) _tot+= _ng[k];
+	}
+	_t.resize((long)_ni*_nk);
+	for (int it=0;it<_ni;++it)
+		for (int k=0;k<_nk;++k)
+			_t[(long)it*_nk+k]= (uint8_t)gl[k][it];
+	return true;
+}
+
+bool OCFNFused::tally(const int *c,int *mx,int *nd) const
+{
+	// Find each item's row of the table, then go down each column in turn, so its running count and mask stay in registers
+	const uint8_t *r[256];
+	for (int j=0;j<_clen;++j)
+	{
+		if (c[j]<0||c[j]>=_ni) return false;
+		r[j]= &(_t[(long)c[j]*_nk]);
+	}
+	uint8_t n[MaxCols*MaxGroups];
+	memset(n,0,_tot);
+	for (int k=0;k<_nk;++k)
+	{
+		if (!_wcnt[k])
+		{
+			uint64_t m= 0;
+			for (int j=0;j<_clen;++j) m|= 1ULL<<r[j][k];
+			int d= 0;
+			for (;m;m&= m-1) ++d;	// At most _clen bits are set
+			nd[k]= d;
+			continue;
+		}
+		uint8_t *nc= n+_off[k];
+		int hi= 0;
+		for (int j=0;j<_clen;++j)
+		{
+			int x= ++nc[r[j][k]];
+			hi= (x>hi)?x:hi;
+		}
+		mx[k]= hi;
+		if (_wmask[k])
+		{
+			int d= 0;
+			for (int g=0;g<_ng[k];++g) d+= (nc[g]>0);
+			nd[k]= d;
+		}
+	}
+	return true;
+}
+
+int OCFNFused::Test(const int *c) const
+{
+	if (!c) return -1;
+	int mx[MaxCols];
+	int nd[MaxCols];
+	bool done= false, ok= true;
+	for (int i=0;i<_ncfn;++i)
+	{
+		if (_kind[i]<0)
+		{
+			if (_cfn[i]&&!_cfn[i]->Test(c)) return i;
+			continue;
+		}
+		if (!done)
+		{
+			ok= tally(c,mx,nd);
+			done= true;
+		}
+		if (!ok) return i;
+		int k= _col[i];
+		if (_kind[i]==OCFNMinGroups::SType()?(nd[k]<_cnt[i]):(mx[k]>_cnt[i])) return i;
+	}
+	return -1;
 }
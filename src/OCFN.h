@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include <set>
 #include <string>
+#include <vector>
 #include "OMutex.h"
 class OConfig;
 
@@ -20,7 +21,7 @@ First, note that a user defined class can only be called via C++.  At present we
 
 Derive from OCFN, and pick a "type" id that is >1  (the two intrinsic types are 0 and 1) and doesn't conflict with any other of your user-defined types.  This actually is irrelevant at this point, but good practice for future use.
 
-Write the init(), test(), desc(), gettype(), and isvalid() fns, as well as a virtual destructor if needed. 
+Write the init(), test(), desc(), gettype(), and isvalid() fns, as well as a virtual destructor if needed.  Note that test() may be called concurrently from several threads by the parallel search, so it must not modify any member state. 
 
 To use, construct an instance of the specified fns, passing whatever config info is needed via the constructor parms.  Add the pointer to the instance via OConfig::SetConstraint().  Note that once passed in, ownership is assumed by OConfig.  
 
@@ -69,6 +70,9 @@ protected:
 public:
 	OCFNGrpCntBase(const OConfig *src,int fnum);	// fnum= feature num
 	virtual ~OCFNGrpCntBase(void) { this->reset(); }
+	int FeatureNum(void) const { return _fn; }
+	int NumGroups(void) const { return _ng; }
+	const int *GroupOf(void) const { return _l; }	// Group of each item.  NULL until init'ed.
 	virtual bool init(void);
 	virtual bool isvalid(void) const;
 	virtual std::string desc(void) const;
@@ -83,6 +87,7 @@ protected:
 public:
 	OCFNMinGroups(const OConfig *src,int fnum,int mcnt);	// fnum= feature num, mcnt= min count
 	~OCFNMinGroups(void) { this->reset(); }
+	int Count(void) const { return _cnt; }
 	virtual bool init(void);
 	virtual bool test(const int *) const;
 	virtual bool isvalid(void) const;
@@ -97,10 +102,10 @@ class OCFNMaxItems : public OCFNGrpCntBase
 {
 protected:
 	int _cnt;	// Max count of items allowed in a group
-	mutable int *_x;	// Counts for groups.  Length _ng.  (tmp used in Test() only)
 public:
 	OCFNMaxItems(const OConfig *src,int fnum,int mcnt);	// fnum= feature num, mcnt= max count
 	~OCFNMaxItems(void) { this->reset(); }
+	int Count(void) const { return _cnt; }
 	virtual bool init(void);
 	virtual bool test(const int *) const;
 	virtual bool isvalid(void) const;
@@ -110,4 +115,35 @@ public:
 	virtual void reset(void);
 };
 
+/* The built-in group-count constraints, evaluated together.
+
+Rather than each constraint going over the collection on its own, we go over it once.  The features the built-in constraints use become the columns of a table giving each item's group in each, and as we go we count the items from each group of a column (in bytes, since collections are small) and keep the largest count if a max items constraint needs it, or set a bit for each group seen if a min groups constraint needs the number of groups, which is then a popcount.  Each constraint then is a comparison.  They're still checked in order, and any others (user-defined, or on a feature with too many groups) are tested as usual in their turn, so the constraint reported as violated is the same.
+*/
+class OCFNFused
+{
+protected:
+	enum { MaxCols= 8, MaxGroups= 256 };
+	int _clen;		// Items in collection
+	int _ni;		// Number of items
+	int _nk;		// Number of columns
+	int _ng[MaxCols];	// Groups in each column
+	int _off[MaxCols];	// Where each column's counters start
+	bool _wcnt[MaxCols];	// Column needs its counts (a max items constraint, or too many groups for a mask)
+	bool _wmask[MaxCols];	// Column needs its number of groups (a min groups constraint)
+	int _tot;		// Counters in all
+	std::vector<uint8_t> _t;	// Group of each item in each column.  _nk per item.
+	const OCFN *const *_cfn;	// The constraints, in order
+	int _ncfn;
+	std::vector<int> _kind;		// Of each constraint: OCFNMinGroups::SType(), OCFNMaxItems::SType(), or -1 if it's tested on its own
+	std::vector<int> _col;		// Column of each fused constraint
+	std::vector<int> _cnt;		// And its count
+	int _nfused;
+	bool tally(const int *c,int *mx,int *nd) const;	// Go over collection c, filling in the largest count and number of groups for each column.  False if c has a bad item.
+public:
+	OCFNFused(void) : _clen(0), _ni(0), _nk(0), _tot(0), _t(), _cfn(NULL), _ncfn(0), _kind(), _col(), _cnt(), _nfused(0) {}
+	bool Build(const OConfig *src,const OCFN *const *cfn,int n);	// Compile those of the n constraints cfn (all init'ed) which we can.  False if none.
+	int Test(const int *c) const;	// As OConfig::TestConstraints()
+	int NumFused(void) const { return _nfused; }
+};
+
 #endif
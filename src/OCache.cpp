@@ -0,0 +1,125 @@
+#include <string.h>
+#include "OCache.h"
+
+// 2M combos: a few tens of MB at most, and every group but a flex slot over a big slate fits
+OComboCache::OComboCache(void) : OMtxCtlBase(), _c(), _max(1L<<21), _ncomb(0), _clock(0), _nhit(0), _nreuse(0), _nmiss(0) {}
+
+OComboCache &OComboCache::Global(void)
+{
+	static OComboCache foo;
+	return foo;
+}
+
+void OComboCache::enumerate(int ni,int np,long nc,std::vector<int16_t> &t)
+{
+	t.resize(nc*np);
+	std::vector<int> p(np);
+	for (int j=0;j<np;++j) p[j]= j;
+	for (long k=0;k<nc;++k)
+	{
+		for (int j=0;j<np;++j) t[k*np+j]= (int16_t)p[j];
+		int j= np-1;
+		while (j>=0&&p[j]==ni-np+j) --j;
+		if (j<0) break;
+		++p[j];
+		for (int l=j+1;l<np;++l) p[l]= p[l-1]+1;
+	}
+}
+
+bool OComboCache::same(const std::vector<float> &a,const float *b,int n)
+{
+	return ((int)a.size()==n&&memcmp(&(a[0]),b,n*sizeof(float))==0);
+}
+
+void OComboCache::evict(long room)
+{
+	while (!_c.empty()&&_ncomb+room>_max)
+	{
+		CMAP::iterator lru= _c.begin();
+		for (CMAP::iterator ii= _c.begin();ii!=_c.end();++ii)
+			if (ii->second._used<lru->second._used) lru= ii;
+		_ncomb-= lru->second._nc;
+		_c.erase(lru);
+	}
+}
+
+int OComboCache::Lookup(const int *n,int ni,int np,long nc,const float *iv,const float *ic,std::vector<int16_t> &t,std::vector<float> &sv,std::vector<float> &sc)
+{
+	if (!n||!iv||!ic||ni<=0||np<=0||nc<=0||ni>32767) return 0;
+	KEY k(np,std::vector<int>(n,n+ni));
+	{
+		OCCMtxCtl mtx(this);
+		if (nc>_max) return 0;
+		CMAP::iterator ii= _c.find(k);
+		if (ii!=_c.end())
+		{
+			OCCEnt &e= ii->second;
+			e._used= ++_clock;
+			t= e._t;
+			if (same(e._iv,iv,ni)&&same(e._ic,ic,ni))
+			{
+				sv= e._sv;
+				sc= e._sc;
+				++_nreuse;
+				return 2;
+			}
+			++_nhit;
+			return 1;
+		}
+		++_nmiss;
+	}
+
+	// Enumerate without the lock, since the other groups may want it meanwhile
+	enumerate(ni,np,nc,t);
+
+	OCCMtxCtl mtx(this);
+	if (nc>_max||_c.find(k)!=_c.end()) return 1;		// Shrunk meanwhile, or another thread beat us to it
+	evict(nc);
+	OCCEnt &e= _c[k];
+	e._t= t;
+	e._nc= nc;
+	e._used= ++_clock;
+	_ncomb+= nc;
+	return 1;
+}
+
+void OComboCache::Store(const int *n,int ni,int np,const float *iv,const float *ic,const int *t,const float *sv,const float *sc)
+{
+	KEY k(np,std::vector<int>(n,n+ni));
+	OCCMtxCtl mtx(this);
+	CMAP::iterator ii= _c.find(k);
+	if (ii==_c.end()) return;	// Evicted meanwhile
+	OCCEnt &e= ii->second;
+	e._t.assign(t,t+e._nc*np);
+	e._iv.assign(iv,iv+ni);
+	e._ic.assign(ic,ic+ni);
+	e._sv.assign(sv,sv+e._nc);
+	e._sc.assign(sc,sc+e._nc);
+}
+
+void OComboCache::SetLimit(long maxcombos)
+{
+	OCCMtxCtl mtx(this);
+	_max= (maxcombos>0)?maxcombos:0;
+	evict(0);
+}
+
+void OComboCache::Clear(void)
+{
+	OCCMtxCtl mtx(this);
+	_c.clear();
+	_ncomb= 0;
+	_nhit= 0;
+	_nreuse= 0;
+	_nmiss= 0;
+}
+
+void OComboCache::Stats(long *hits,long *reuses,long *misses,long *entries,long *combos) const
+{
+	OCCMtxCtl mtx(this);
+	if (hits) *hits= _nhit;
+	if (reuses) *reuses= _nreuse;
+	if (misses) *misses= _nmiss;
+	if (entries) *entries= _c.size();
+	if (combos) *combos= _ncomb;
+}
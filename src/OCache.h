@@ -0,0 +1,61 @@
+#ifndef OCACHEDEFFLAG
+#define OCACHEDEFFLAG
+
+#include <map>
+#include <vector>
+#include <inttypes.h>
+#include "OMutex.h"
+
+/* Process-wide cache of the combos of primary groups scanned by value.
+
+Which picks make up each combo depends only on the items in the group and the number picked, not on their values or costs.  A slate which is searched again (with new projections, or another maxcost) therefore has the same combos, and only their sums and order need recomputing.  We keep every combo of a group, as positions into its item list, keyed by (picks, items).  Along with them we keep the order we last sorted them into and their sums, and the item values and costs that was for.  If those are unchanged (only maxcost or the other settings differ), even the sort is reused: the combos which fit the budget just are picked out in order.
+
+A group scanned by value has every combo generated anyway (see OSGrpCombos::build()), so listing them is no loss even on a miss.  One scanned by cost only ever generates those which fit, so isn't cached.  Entries are evicted least recently used once they hold more than the limit in all, and a group with more combos than the limit never is cached.
+
+Safe to use from several threads (the groups of a search are built concurrently).
+*/
+class OComboCache : public OMtxCtlBase
+{
+private:
+	OComboCache(const OComboCache &x) {}
+protected:
+	typedef OMtxCtl<OComboCache> OCCMtxCtl;
+	friend class OMtxCtl<OComboCache>;
+
+	typedef std::pair<int,std::vector<int> > KEY;	// Picks, items
+	struct OCCEnt
+	{
+		std::vector<int16_t> _t;	// Positions of the picks of each combo, ascending.  np per combo.
+		std::vector<float> _iv;		// Item values and costs _t is sorted for.  Empty if it isn't (it's in lexicographic order).
+		std::vector<float> _ic;
+		std::vector<float> _sv;		// Then, the value and cost of each combo
+		std::vector<float> _sc;
+		long _nc;		// Number of combos
+		long _used;		// When last used (a tick of _clock)
+	};
+	typedef std::map<KEY,OCCEnt> CMAP;
+	CMAP _c;
+	long _max;		// Most combos held in all.  0 disables the cache.
+	long _ncomb;		// Combos held
+	long _clock;		// Ticks at every lookup
+	long _nhit;		// Lookups found, but which had to be re-sorted
+	long _nreuse;		// Lookups found with the same values and costs, so the order was reused
+	long _nmiss;		// Lookups not found (and then added)
+
+	void evict(long room);		// Drop the least recently used entries until room more combos fit
+	static void enumerate(int ni,int np,long nc,std::vector<int16_t> &t);	// Every combo of np of ni positions, in lexicographic order
+	static bool same(const std::vector<float> &a,const float *b,int n);	// Is a bitwise the same as b[0..n)?
+public:
+	OComboCache(void);
+	static OComboCache &Global(void);	// The one the search uses
+
+	// Look up the nc combos of np of the ni items n, whose values and costs are iv, ic (length ni).  Returns 2 if we have them sorted for those values and costs: t, sv and sc get the combos in order and their sums.  Returns 1 if we have them otherwise, or have just enumerated (and cached) them: t gets them in some order.  0 if nc is more than the cache may hold, or it is disabled.
+	int Lookup(const int *n,int ni,int np,long nc,const float *iv,const float *ic,std::vector<int16_t> &t,std::vector<float> &sv,std::vector<float> &sc);
+	void Store(const int *n,int ni,int np,const float *iv,const float *ic,const int *t,const float *sv,const float *sc);	// Having sorted the combos Lookup() gave (t has np positions per combo), keep that order and the sums for next time
+	void SetLimit(long maxcombos);	// Hold at most this many combos in all.  0 disables (and empties) the cache.
+	long Limit(void) const { return _max; }
+	void Clear(void);		// Empty the cache and zero the stats
+	void Stats(long *hits,long *reuses,long *misses,long *entries,long *combos) const;	// Any may be NULL.  hits doesn't include reuses.
+};
+
+#endif
@@ -1,64 +1,342 @@
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <algorithm>
 #include "OColl.h"
+#include "OPool.h"
+
+/////////// OCollCodec
+
+void OCollCodec::AddLevel(long nc,int np,int tloc,const void *it,int iw)
+{
+	int b= 0;
+	while (b<63&&(1L<<b)<nc) ++b;
+	_off.push_back(_nl?(_off.back()+_bits.back()):0);
+	_bits.push_back(b);
+	_np.push_back(np);
+	_iw.push_back(iw);
+	_it.push_back(std::vector<char>((const char *)it,(const char *)it+nc*np*iw));
+	if (_clen<tloc+np)
+	{
+		_clen= tloc+np;
+		_sl.resize(_clen,0);
+		_sk.resize(_clen,0);
+	}
+	for (int k=0;k<np;++k)
+	{
+		_sl[tloc+k]= _nl;
+		_sk[tloc+k]= k;
+	}
+	++_nl;
+	_nbytes= (_off.back()+_bits.back()+7)/8;
+}
+
+void OCollCodec::Pack(char *o,const long *ci) const
+{
+	unsigned char *p= (unsigned char *)o;
+	memset(p,0,_nbytes);
+	for (int g=0;g<_nl;++g)
+	{
+		uint64_t x= ci[g];
+		for (int k=0,b=_off[g];k<_bits[g];)
+		{
+			int n= std::min(8-(b&7),_bits[g]-k);
+			p[b>>3]|= (unsigned char)(((x>>k)&((1U<<n)-1))<<(b&7));
+			b+= n;
+			k+= n;
+		}
+	}
+}
+
+long OCollCodec::Combo(const char *o,int g) const
+{
+	const unsigned char *p= (const unsigned char *)o;
+	long x= 0;
+	for (int k=0,b=_off[g];k<_bits[g];)
+	{
+		int n= std::min(8-(b&7),_bits[g]-k);
+		x|= (long)((p[b>>3]>>(b&7))&((1U<<n)-1))<<k;
+		b+= n;
+		k+= n;
+	}
+	return x;
+}
 
 /////////// OCollMM
 
-OCollMM::OCollMM(int clen,int bsize,long maxrec,float ctol) : OMtxCtlBase(), _s(), _c(), _cii(_c.end()), _rsize(0), _bsize(bsize), _clen(clen), _maxrec(maxrec), _ctol(ctol), _nreqs(0), _ncurr(0), _maxval(BadVal()), _minval(BadVal())
+OCollMM::OCollMM(int clen,int bsize,long maxrec,float ctol,int iw) : OMtxCtlBase(), _local(false), _a(), _nnew(0), _free(), _hp(), _seq(), _nseq(0), _cii(0), _ram(0), _sdir(), _fd(-1), _flen(0), _runs(), _mq(), _nspill(0), _rsize(0), _bsize(bsize), _clen(clen), _iw(iw), _maxrec(maxrec), _ctol(ctol), _nreqs(0), _ncurr(0), _maxval(BadVal()), _minval(BadVal()), _bar(BadVal()), _dedup(false), _h(), _ka(NULL), _kb(NULL), _ndup(0), _sv(), _si(), _cd(NULL), _owncd(false), _sink(NULL), _quiet(false)
 {
-	_rsize= _clen*sizeof(int16_t) + sizeof(float);
+	_rsize= _clen*_iw + sizeof(float);
+	_ka= new int [_clen];
+	_kb= new int [_clen];
 }
 
 OCollMM::~OCollMM(void)
 {
-	for (BSET::iterator ii= _s.begin();ii!=_s.end();++ii)
-		delete [] *ii;
+	for (size_t r=0;r<_runs.size();++r)
+		munmap(_runs[r]._p,_runs[r]._len);
+	if (_fd>=0) close(_fd);
+	if (_owncd) delete _cd;
+	delete [] _ka;
+	delete [] _kb;
 }
 
-void OCollMM::addblock(void)
+void OCollMM::SetDedup(bool x)
 {
-	// Allocate new block
-	char *b= new char [_bsize*_rsize];
+	OCMMMtxCtl mtx(lockme());
+	_dedup= x;
+}
 
-	// 0 out the new block except for the val which we set to bad (so at end of sort)
-	memset(b,0,_bsize*_rsize);
-	for (int i=0;i<_bsize;++i)
-		Unset(b+i*_rsize);
+void OCollMM::SetSink(OCollSink *x)
+{
+	OCMMMtxCtl mtx(lockme());
+	_sink= x;
+}
 
-	// Add to Set of blocks
-	_s.insert(b);
+bool OCollMM::SetCodec(const OCollCodec *x,bool own)
+{
+	OCMMMtxCtl mtx(lockme());
+	if (_nreqs>0||!_a.empty()) return false;
+	if (_owncd) delete _cd;
+	_cd= x;
+	_owncd= own;
+	_rsize= sizeof(float)+(_cd?_cd->NumBytes():_clen*_iw);
+	return true;
+}
 
-	// Add all empty records to Set of recs
-	for (int i=0;i<_bsize;++i) _c.insert(b+i*_rsize);
+void OCollMM::SetSpill(long ram,const char *dir)
+{
+	OCMMMtxCtl mtx(lockme());
+	_ram= (ram>0)?ram:0;
+	_sdir= (dir)?dir:"";
 }
 
-bool OCollMM::CanAdd(float v) const
+void OCollMM::SetLocal(bool x)
 {
-	if (IsBadVal(v)) return false;			// Bad value can't be added
-	if (!IsBadVal(_maxval)&&v<_maxval*(1.0-_ctol)) return false;		// Falls below the threshold relative to max value so far
-	if (IsFull()&&!IsBadVal(_minval)&&v<=_minval) return false;		// Already full and can't displace a lower entry
+	_local= x;
+}
+
+// splitmix64's finalizer.  A collection's hash is the sum over its items, so doesn't depend on their order.
+uint64_t OCollMM::hashitem(int n)
+{
+	uint64_t z= (uint64_t)n+0x9E3779B97F4A7C15ULL;
+	z= (z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+	z= (z^(z>>27))*0x94D049BB133111EBULL;
+	return z^(z>>31);
+}
+
+bool OCollMM::samecoll(const char *o,const int *c) const
+{
+	for (int j=0;j<_clen;++j)
+	{
+		_ka[j]= GetItem(o,j);
+		_kb[j]= c[j];
+	}
+	std::sort(_ka,_ka+_clen);
+	std::sort(_kb,_kb+_clen);
+	return std::equal(_ka,_ka+_clen,_kb);
+}
+
+void OCollMM::unhash(long k)
+{
+	if (!_dedup) return;
+	const char *o= rec(k);
+	uint64_t h= 0;
+	for (int j=0;j<_clen;++j) h+= hashitem(GetItem(o,j));
+	std::pair<HMAP::iterator,HMAP::iterator> r= _h.equal_range(h);
+	for (HMAP::iterator ii= r.first;ii!=r.second;++ii)
+		if (ii->second==k)
+		{
+			_h.erase(ii);
+			return;
+		}
+}
+
+bool OCollMM::spilleddup(uint64_t h,const int *c) const
+{
+	for (size_t r=0;r<_runs.size();++r)
+	{
+		const std::vector<std::pair<uint64_t,long> > &hs= _runs[r]._hs;
+		std::vector<std::pair<uint64_t,long> >::const_iterator ii= std::lower_bound(hs.begin(),hs.end(),std::make_pair(h,-1L));
+		for (;ii!=hs.end()&&ii->first==h;++ii)
+			if (samecoll(runrec(r,ii->second),c)) return true;
+	}
+	return false;
+}
+
+bool OCollMM::spill(void)
+{
+	long n= _hp.size();
+	if (n<=0) return true;
+	sortheap(1);
+
+	// Create the scratch file the first time
+	if (_fd<0)
+	{
+		std::string d= _sdir;
+		if (d.empty())
+		{
+			const char *t= getenv("TMPDIR");
+			d= (t&&*t)?t:"/tmp";
+		}
+		std::string f= d+"/ccsspillXXXXXX";
+		std::vector<char> fn(f.begin(),f.end());
+		fn.push_back(0);
+		_fd= mkstemp(&(fn[0]));
+		if (_fd<0)
+		{
+			printf("ERROR: CollMM can't create a spill file in %s.  Keeping everything in memory.\n",d.c_str());
+			_ram= 0;
+			return false;
+		}
+		unlink(&(fn[0]));
+	}
+
+	// Map the run's stretch of the file.  Allocating it first means a full disk is an error here, rather than a crash when we write to the mapping.
+	long pg= sysconf(_SC_PAGESIZE);
+	size_t off= ((_flen+pg-1)/pg)*pg;
+	OCollRun x;
+	x._len= n*SpillSize();
+	x._n= n;
+	void *p= (posix_fallocate(_fd,off,x._len)==0)?mmap(NULL,x._len,PROT_READ|PROT_WRITE,MAP_SHARED,_fd,off):MAP_FAILED;
+	if (p==MAP_FAILED)
+	{
+		printf("ERROR: CollMM can't grow its spill file.  Keeping everything in memory.\n");
+		_ram= 0;
+		return false;
+	}
+	x._p= (char *)p;
+	_flen= off+x._len;
+
+	// Write the records out in result order, and free their slots
+	for (long i=0;i<n;++i)
+	{
+		long k= resslot(i);
+		int64_t q= _seq[k];
+		memcpy(x._p+i*SpillSize(),&q,sizeof(int64_t));
+		memcpy(x._p+i*SpillSize()+sizeof(int64_t),rec(k),_rsize);
+		if (_dedup)
+		{
+			uint64_t h= 0;
+			for (int j=0;j<_clen;++j) h+= hashitem(GetItem(rec(k),j));
+			x._hs.push_back(std::make_pair(h,i));
+		}
+	}
+	std::sort(x._hs.begin(),x._hs.end());
+	msync(x._p,x._len,MS_ASYNC);	// Start writing it out, and let go of the pages.  The file keeps what we wrote.
+	madvise(x._p,x._len,MADV_DONTNEED);
+	_runs.push_back(x);
+	_hp.clear();
+	_free.clear();	// All the slots are free again
+	_nnew= 0;
+	_h.clear();
+	_nspill+= n;
+	setmin();
 	return true;
 }
 
-char *OCollMM::droplowest(bool isbad)
+// A seed which has been dropped can't be offered again anyway, since the bar it fell below only rises
+bool OCollMM::isseed(const int *c,float v) const
 {
-	// Drop the entry
-	CSET::iterator ii= _c.end();
-	--ii;
-	char *o= *ii;
-	_c.erase(ii);
-	if (isbad) return o;	// We know the entry is a blank
+	bool sorted= false;
+	for (size_t k=0;k<_sv.size();++k)
+	{
+		if (_sv[k]!=v) continue;
+		if (!sorted)
+		{
+			for (int j=0;j<_clen;++j) _kb[j]= c[j];
+			std::sort(_kb,_kb+_clen);
+			sorted= true;
+		}
+		if (std::equal(_kb,_kb+_clen,_si.begin()+k*_clen)) return true;
+	}
+	return false;
+}
 
-	--_ncurr;
-	// Update extrema if needed
-	if (_c.empty()) _minval= _maxval= BadVal();
-	else
+bool OCollMM::AddSeed(int *c,const long *ci,float v)
+{
+	if (!Add(false,c,ci,v,NULL,-1)) return false;
+	OCMMMtxCtl mtx(lockme());
+	_sv.push_back(v);
+	_si.insert(_si.end(),c,c+_clen);
+	std::sort(_si.end()-_clen,_si.end());
+	return true;
+}
+
+long OCollMM::newslot(void)
+{
+	if (!_free.empty())
+	{
+		long k= _free.back();
+		_free.pop_back();
+		return k;
+	}
+	if (_nnew==GetNumRecAlloc())
 	{
-		ii= _c.end();
-		--ii;
-		_minval= GetVal(*ii);
+		// Grow the arena by a block.  Blank records needn't be initialized.
+		long n= GetNumRecAlloc();
+		_a.resize((n+_bsize)*_rsize);
+		_seq.resize(n+_bsize,0);
 	}
-	return o;
+	return _nnew++;
+}
+
+void OCollMM::siftup(long i)
+{
+	long k= _hp[i];
+	while (i>0)
+	{
+		long p= (i-1)/2;
+		if (!below(k,_hp[p])) break;
+		_hp[i]= _hp[p];
+		i= p;
+	}
+	_hp[i]= k;
+}
+
+void OCollMM::siftdown(long i)
+{
+	long k= _hp[i], n= _hp.size();
+	for (;;)
+	{
+		long c= 2*i+1;
+		if (c>=n) break;
+		if (c+1<n&&below(_hp[c+1],_hp[c])) ++c;
+		if (!below(_hp[c],k)) break;
+		_hp[i]= _hp[c];
+		i= c;
+	}
+	_hp[i]= k;
+}
+
+long OCollMM::poplowest(void)
+{
+	long k= _hp[0];
+	long l= _hp.back();
+	_hp.pop_back();
+	if (!_hp.empty())
+	{
+		_hp[0]= l;
+		siftdown(0);
+	}
+	unhash(k);
+	--_ncurr;
+	if (_sink) _sink->Retract(_seq[k]);
+	return k;
+}
+
+void OCollMM::setbar(void)
+{
+	float b= GetMinAllowed();
+	if (IsFull()&&!IsBadVal(_minval)&&(IsBadVal(b)||_minval>b)) b= _minval;
+	_bar.store(b,std::memory_order_relaxed);
+}
+
+bool OCollMM::CanAdd(float v) const
+{
+	return canadd(v,_nseq);
 }
 
 // This does a very quick test whether necessary. 
@@ -66,63 +344,145 @@ void OCollMM::gc(void)
 {
 	float mv= GetMinAllowed();
 	if (IsBadVal(_minval)||_minval>=mv) return;
-	bool cut= false;
-	float newmin=BadVal();
-	for (CSET::reverse_iterator rii= _c.rbegin(); rii!= _c.rend(); ++rii)
+	while (!_hp.empty()&&GetVal(rec(_hp[0]))<mv)
+		_free.push_back(poplowest());
+	setmin();
+	setbar();
+}
+
+bool OCollMM::Add(bool verbose,int *c,float v,bool *dup)
+{
+	OCMMMtxCtl mtx(lockme());
+	return add(verbose,c,NULL,v,dup,-1);
+}
+
+bool OCollMM::Add(bool verbose,int *c,const long *ci,float v,bool *dup,long seq)
+{
+	OCMMMtxCtl mtx(lockme());
+	return add(verbose,c,ci,v,dup,seq);
+}
+
+void OCollMM::Merge(const OCollMM &x)
+{
+	OCMMMtxCtl mtx(lockme());
+	_quiet= (x._sink!=NULL);	// Then x told the sink of its records as it took them, so we need only say which we turn away
+	int *c= new int [_clen];
+	int nl= x._cd?x._cd->NumLevels():0;
+	long *ci= new long [nl+1];
+	for (size_t i=0;i<x._hp.size();++i)
 	{
-		float v= GetVal(*rii);
-		if (IsBadVal(v)) continue;
-		if (v>=mv)
+		const char *o= x.rec(x._hp[i]);
+		for (int j=0;j<_clen;++j) c[j]= x.GetItem(o,j);
+		for (int g=0;g<nl;++g) ci[g]= x._cd->Combo(o+sizeof(float),g);
+		if (!add(false,c,ci,x.GetVal(o),NULL,x._seq[x._hp[i]])&&_quiet) _sink->Retract(x._seq[x._hp[i]]);
+	}
+	for (size_t r=0;r<x._runs.size();++r)
+		for (long i=0;i<x._runs[r]._n;++i)
 		{
-			newmin= v;
-			break;
+			const char *o= x.runrec(r,i);
+			for (int j=0;j<_clen;++j) c[j]= x.GetItem(o,j);
+			for (int g=0;g<nl;++g) ci[g]= x._cd->Combo(o+sizeof(float),g);
+			if (!add(false,c,ci,x.runval(r,i),NULL,x.runseq(r,i))&&_quiet) _sink->Retract(x.runseq(r,i));
 		}
-		Unset(*rii);
-		--_ncurr;
-		cut= true;
-	}
-	if (cut) _minval= newmin;
+	_quiet= false;
+	delete [] ci;
+	delete [] c;
 }
 
-bool OCollMM::Add(bool verbose,int *c,float v)
+bool OCollMM::canadd(float v,long seq) const
+{
+	if (IsBadVal(v)) return false;			// Bad value can't be added
+	if (!IsBadVal(_maxval)&&v<_maxval*(1.0-_ctol)) return false;		// Falls below the threshold relative to max value so far
+	if (IsFull()&&!IsBadVal(_minval)&&(v<_minval||(v==_minval&&seq>=_seq[_hp[0]]))) return false;		// Already full and can't displace a lower entry (or a tied later one)
+	return true;
+}
+
+bool OCollMM::add(bool verbose,int *c,const long *ci,float v,bool *dup,long seq)
 {
-	OCMMMtxCtl mtx(this);
 	++_nreqs;
 
 	if (!c) return false;
-	if (!CanAdd(v)) return false;
+	if (_cd&&!ci) return false;	// Can't pack it
+	if (seq<0) seq= _nseq;
+	if (!canadd(v,seq)) return false;
+
+	// Do we have it already?
+	uint64_t h= 0;
+	if (_dedup)
+	{
+		for (int j=0;j<_clen;++j) h+= hashitem(c[j]);
+		std::pair<HMAP::iterator,HMAP::iterator> r= _h.equal_range(h);
+		for (HMAP::iterator ii= r.first;ii!=r.second;++ii)
+			if (samecoll(rec(ii->second),c))
+			{
+				// The same items summed in another order can differ in the last bit.  Keep the higher, as we would have if we'd kept both.
+				long k= ii->second;
+				if (v>GetVal(rec(k)))
+				{
+					SetVal(rec(k),v);
+					siftdown(std::find(_hp.begin(),_hp.end(),k)-_hp.begin());	// This is rare, so we don't keep track of where each slot is in the heap
+					if (v>_maxval) _maxval= v;
+					setmin();
+					setbar();
+					if (_sink)
+					{
+						_sink->Retract(_seq[k]);
+						_sink->Accept(_seq[k],c,_clen,v);
+					}
+				}
+				++_ndup;
+				if (dup) *dup= true;
+				return false;
+			}
+		if (!_runs.empty()&&spilleddup(h,c))	// A spilled record can't be moved, so keeps its value even if this is a hair higher
+		{
+			++_ndup;
+			if (dup) *dup= true;
+			return false;
+		}
+	}
+
+	if (!_sv.empty()&&isseed(c,v))
+	{
+		++_ndup;
+		if (dup) *dup= true;
+		return false;
+	}
 
 	// Obtain a record
-	char *o= NULL;
 	if (IsFull()) 
 	{
 		if (verbose) printf("CollMM: Performing GC\n");
 		gc();
 	}
-	if (IsFull())	// If still is full after gc
-	{
-		o= droplowest(false);  // If at legal limit, drop the lowest entry and use that.  
-	}
-	else 
+	else if (_free.empty()&&_nnew==GetNumRecAlloc()&&_ram>0&&_maxrec<=0&&GetNumRecAlloc()>0&&(GetNumRecAlloc()+_bsize)*slotsize()>_ram)	// Growing the arena would go over budget
 	{
-		if (GetNumRec()==GetNumRecAlloc()) addblock();	// If current blocks full, add one
-		o= droplowest(true); // No reason not to just pull the last (now known to be unset) record since it will be sorted back in
+		gc();	// Perhaps enough have fallen below the threshold
+		if (_free.empty()&&verbose) printf("CollMM: Spilling %ld records\n",(long)_hp.size());
+		if (_free.empty()) spill();
 	}
-	assert(o);
-	if (!o) return false;
+	long k= IsFull()?poplowest():newslot();	// If still at the legal limit after gc, drop the lowest entry and use its slot
+	char *o= rec(k);
 
 	// Populate the record
-	for (int j=0;j<_clen;++j)
+	if (_cd) _cd->Pack(o+sizeof(float),ci);
+	else for (int j=0;j<_clen;++j)
 		SetItem(o,j,c[j]);
 	SetVal(o,v);
 
-	// Reinsert back into set (so it's in the correct order)
-	_c.insert(o);
+	// Onto the heap
+	_seq[k]= seq;
+	if (seq>=_nseq) _nseq= seq+1;
+	_hp.push_back(k);
+	siftup(_hp.size()-1);
+	if (_dedup) _h.insert(HMAP::value_type(h,k));
 
 	// Update parms
 	++_ncurr;
 	if (IsBadVal(_maxval)||v>_maxval) _maxval= v;
-	if (IsBadVal(_minval)||v<_minval) _minval= v;
+	setmin();
+	setbar();
+	if (_sink&&!_quiet) _sink->Accept(seq,c,_clen,v);
 
 	// Done
 	if (verbose) 
@@ -131,34 +491,206 @@ bool OCollMM::Add(bool verbose,int *c,float v)
 }
 
 
+// Heap order: the reverse of result order (descending value, then earliest in order)
+struct OCollHeapLess
+{
+	const OCollMM *_m;
+	OCollHeapLess(const OCollMM *m) : _m(m) {}
+	bool operator()(long a,long b) const { return _m->ResBefore(b,a); }
+};
+
+// Sorts one chunk of the heap
+class OCollSortJob : public OPoolJob
+{
+public:
+	const OCollMM *_m;
+	long *_o;
+	long _n,_cs;		// Slots, and per chunk
+	OCollSortJob(const OCollMM *m,long *o,long n,long cs) : _m(m), _o(o), _n(n), _cs(cs) {}
+	void Run(int w,long t) { std::sort(_o+t*_cs,_o+std::min(_n,(t+1)*_cs),OCollHeapLess(_m)); }
+};
+
+// Result order of the merge heap's runs.  std::make_heap() etc. put the greatest first, so this is reversed.
+struct OCollRunLess
+{
+	const OCollMM *_m;
+	OCollRunLess(const OCollMM *m) : _m(m) {}
+	bool operator()(int a,int b) const { return _m->RunBefore(b,a); }
+};
+
+void OCollMM::InitResIter(int nw)
+{
+	OCMMMtxCtl mtx(lockme());
+	gc();
+	sortheap(nw);
+	_cii= 0;
+	if (_runs.empty())
+	{
+		if (_sink) _sink->Final(_ncurr);
+		return;
+	}
+
+	// Merge what's in memory with the runs.  Each is sorted, so those fallen below the threshold since they were spilled are at the end.
+	float mv= GetMinAllowed();
+	_ncurr= _hp.size();
+	_mq.clear();
+	if (!_hp.empty()) _mq.push_back(-1);
+	for (size_t r=0;r<_runs.size();++r)
+	{
+		OCollRun &x= _runs[r];
+		long lo= 0, hi= x._n;
+		while (lo<hi)
+		{
+			long m= (lo+hi)/2;
+			if (IsBadVal(mv)||!(runval(r,m)<mv)) lo= m+1;
+			else hi= m;
+		}
+		for (long i=lo;i<x._n&&_sink;++i) _sink->Retract(runseq(r,i));
+		x._n= lo;
+		x._i= 0;
+		x._drop= 0;
+		madvise(x._p,x._len,MADV_SEQUENTIAL);
+		_ncurr+= x._n;
+		if (x._n>0) _mq.push_back(r);
+	}
+	std::make_heap(_mq.begin(),_mq.end(),OCollRunLess(this));
+	if (_sink) _sink->Final(_ncurr);
+}
+
+void OCollMM::sortheap(int nw)
+{
+	std::vector<long> &o= _hp;
+	long n= o.size();
+	if (nw<1||n<(1<<16)) nw= 1;	// Not worth threads below this
+	// Sort nw chunks concurrently, then merge them pairwise.  The order is total, so the result doesn't depend on nw.
+	long cs= (n+nw-1)/std::max(nw,1);
+	if (nw>1)
+	{
+		OWorkPool p(nw);
+		OCollSortJob j(this,&(o[0]),n,cs);
+		p.Run(j,nw);
+		for (long w=cs;w<n;w*=2)
+			for (long i=0;i+w<n;i+=2*w)
+				std::inplace_merge(o.begin()+i,o.begin()+i+w,o.begin()+std::min(n,i+2*w),OCollHeapLess(this));
+	}
+	else std::sort(o.begin(),o.end(),OCollHeapLess(this));
+}
+
+const char *OCollMM::nextres(float &v) const
+{
+	if (!_runs.empty())
+	{
+		// Take the next record from whichever run has the best
+		if (_mq.empty()) return NULL;
+		int x= _mq[0];
+		std::pop_heap(_mq.begin(),_mq.end(),OCollRunLess(this));
+		const char *c= (x<0)?rec(resslot(_cii)):runrec(x,_runs[x]._i);
+		v= mergeval(x);
+		bool more= (x<0)?(++_cii<_hp.size()):(++_runs[x]._i<_runs[x]._n);
+		if (x>=0)
+		{
+			// Let go of each MB of the run once it's been read.  Not c's though, which we still need.
+			const OCollRun &y= _runs[x];
+			size_t b= ((y._i-1)*SpillSize())&~(((size_t)1<<20)-1);
+			if (b>y._drop)
+			{
+				madvise(y._p+y._drop,b-y._drop,MADV_DONTNEED);
+				y._drop= b;
+			}
+		}
+		if (more) std::push_heap(_mq.begin(),_mq.end(),OCollRunLess(this));
+		else _mq.pop_back();
+		return c;
+	}
+	if (_cii>=_hp.size()) return NULL;
+	const char *c= rec(resslot(_cii));
+	v= GetVal(c);
+	++_cii;
+	return c;
+}
+
 int OCollMM::GetRes(int n,unsigned int **r,float *m) const
 {
-	OCMMMtxCtl mtx(this);
+	OCMMMtxCtl mtx(lockme());
 	if (n<=0) return -1;
 	if (!r||!m) return -1;
 	int i=0;
-	for (;i<n&&_cii!=_c.end();++i)
-	{
-		char *c= *_cii;
-		if (IsUnset(c)) break;
+	const char *c;
+	for (;i<n&&(c= nextres(m[i]));++i)
 		for (int j=0;j<_clen;++j) 
 			r[i][j]= GetItem(c,j);
-		m[i]= GetVal(c);
-		++_cii;
+	return i;
+}
+
+long OCollMM::GetResFlat(long n,unsigned int *r,float *m,bool sorted) const
+{
+	OCMMMtxCtl mtx(lockme());
+	if (n<=0) return -1;
+	if (!r||!m) return -1;
+	long i=0;
+	const char *c;
+	for (;i<n&&(c= nextres(m[i]));++i)
+	{
+		unsigned int *ri= r+i*_clen;
+		if (!_cd&&_iw==1) for (int j=0;j<_clen;++j) ri[j]= ((const uint8_t *)(c+sizeof(float)))[j];
+		else if (!_cd&&_iw==2) for (int j=0;j<_clen;++j) ri[j]= ((const uint16_t *)(c+sizeof(float)))[j];
+		else for (int j=0;j<_clen;++j) ri[j]= GetItem(c,j);
+		if (sorted) std::sort(ri,ri+_clen);
 	}
 	return i;
 }
 
+const char *OCollMM::ResView(long *n,int *rsize)
+{
+	OCMMMtxCtl mtx(lockme());
+	if (_cd||!_runs.empty()) return NULL;
+	long nr= _hp.size();
+
+	// Move result i to slot i.  Each swap settles one result, so this is a single pass.
+	std::vector<long> at(nr);		// Slot of result i
+	std::vector<long> who(_nnew,-1);	// Result in each slot, -1 if none
+	std::vector<long> to(_nnew,-1);		// Where each slot's record ends up
+	for (long i=0;i<nr;++i)
+	{
+		at[i]= resslot(i);
+		who[at[i]]= i;
+		to[at[i]]= i;
+	}
+	std::vector<char> t(_rsize);
+	for (long i=0;i<nr;++i)
+	{
+		long k= at[i];
+		if (k==i) continue;
+		long j= who[i];
+		memcpy(&(t[0]),rec(i),_rsize);
+		memcpy(rec(i),rec(k),_rsize);
+		memcpy(rec(k),&(t[0]),_rsize);
+		std::swap(_seq[i],_seq[k]);
+		who[k]= j;
+		if (j>=0) at[j]= k;
+		who[i]= i;
+		at[i]= i;
+	}
+	for (long i=0;i<nr;++i) _hp[i]= nr-1-i;
+	for (HMAP::iterator ii=_h.begin();ii!=_h.end();++ii) ii->second= to[ii->second];
+	_free.clear();
+	_nnew= nr;
+	_cii= 0;
+	if (n) *n= nr;
+	if (rsize) *rsize= _rsize;
+	return nr?rec(0):NULL;
+}
+
 std::string OCollMM::GetStatStr(void) const
 {
-	OCMMMtxCtl mtx(this);
+	OCMMMtxCtl mtx(lockme());
 	return getstatstr();
 }
 
 std::string OCollMM::getstatstr(void) const
 {
 	char buf[256];
-	sprintf(buf,"Nreqs:%ld NCurr:%ld Alloc:%ld MinVal:%f MaxVal:%f",GetNumReqs(),GetNumRec(),GetNumRecAlloc(),GetMinVal(),GetMaxVal());
+	sprintf(buf,"Nreqs:%ld NCurr:%ld Alloc:%ld Dups:%ld Spilled:%ld Runs:%d MinVal:%f MaxVal:%f",GetNumReqs(),GetNumRec(),GetNumRecAlloc(),GetNumDups(),GetNumSpilled(),GetNumRuns(),GetMinVal(),GetMaxVal());
 	return buf;
 }
 
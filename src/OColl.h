@@ -1,25 +1,55 @@
 #ifndef OCOLLDEFFLAG
 #define OCOLLDEFFLAG
 
-#include <set>
+#include <vector>
+#include <unordered_map>
 #include <string>
+#include <atomic>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include "OMutex.h"
 #include "OGlobal.h"
+#include "OSink.h"
 
-// Puts into descending order (so true if a>b)
-struct OCollGreaterThan
+/* Packed collections.
+
+A collection found by the search is a choice of combo at each level, so rather than its items we can store the index of each combo, in just enough bits for the number of combos of its level.  The items are looked up again only when read.  We keep a copy of every level's items, since the results outlive the search.
+*/
+class OCollCodec
 {
-	bool operator() (const char *a,const char *b) const
-	{
-		if ( (*((float *)(a))) > (*((float *)(b))) ) return true;
-		else if ( (*((float *)(a))) < (*((float *)(b))) ) return false;
-		else return (a<b);		// Use pointers when vals are same to establish strict ordering
-	}
+protected:
+	int _nl;			// Number of levels
+	int _clen;			// Number of items in a collection
+	int _nbytes;			// Packed size
+	std::vector<int> _bits;		// Bits for each level's combo index
+	std::vector<int> _off;		// Where each level's index starts (in bits)
+	std::vector<int> _np;		// Items per combo of each level
+	std::vector<int> _iw;		// Bytes per item # of each level
+	std::vector<std::vector<char> > _it;	// Items of each combo of each level.  _np[g] per combo, _iw[g] bytes each.
+	std::vector<int> _sl,_sk;	// Level, and item within its combo, of each slot of the collection
+public:
+	OCollCodec(void) : _nl(0), _clen(0), _nbytes(0) {}
+	void AddLevel(long nc,int np,int tloc,const void *it,int iw);	// Add the next level: nc combos of np items (it, iw bytes each) which go in slots tloc on
+	int NumLevels(void) const { return _nl; }
+	int NumBytes(void) const { return _nbytes; }
+	void Pack(char *o,const long *ci) const;	// Pack the combo chosen at each level into o
+	long Combo(const char *o,int g) const;		// Unpack the combo of level g
+	int Item(const char *o,int i) const { int g= _sl[i]; return OGlobal::GetItemAt(&(_it[g][0]),_iw[g],Combo(o,g)*_np[g]+_sk[i]); }	// Item in slot i
 };
 
+// A run of records spilled to the scratch file, sorted in result order
+struct OCollRun
+{
+	char *_p;		// Its mapping.  _n records of OCollMM::SpillSize() bytes: the record's order among equal values (an int64_t), then the record.
+	size_t _len;		// Length of the mapping
+	long _n;		// Number of records (of those spilled, the ones still allowed as of InitResIter())
+	mutable long _i;	// Next to return
+	mutable size_t _drop;	// Bytes at the start already read and let go
+	std::vector<std::pair<uint64_t,long> > _hs;	// The hashes of their items, and where they are, sorted.  Empty unless deduping.
+	OCollRun(void) : _p(NULL), _len(0), _n(0), _i(0), _drop(0), _hs() {}
+};
 
 /* Collection memory manager */
 class OCollMM : public OMtxCtlBase, public OGlobal
@@ -31,20 +61,34 @@ protected:
 	// Mutex control for thread-safety
 	typedef OMtxCtl<OCollMM> OCMMMtxCtl;
 	friend class OMtxCtl<OCollMM>;
+	bool _local;		// Only ever used by one thread, so needn't lock
+	const OCollMM *lockme(void) const { return _local?NULL:this; }
 
-	// A set of blocks (purely for memory allocation purposes in case max size not specified up front)
-	typedef std::set<char *> BSET;
-	BSET _s;
-	
-	// The ordered set of collections (by value).  Sorted by descending value
-	typedef std::set<char *,OCollGreaterThan> CSET;
-	CSET _c;
-	mutable CSET::const_iterator _cii;	// For returning the results
+	// The records live in a single arena, grown _bsize records at a time, and are referred to by their slot number.  Freed slots are reused before new ones are handed out, and those before the arena grows.
+	std::vector<char> _a;
+	long _nnew;			// Slots handed out so far.  Those beyond are untouched.
+	std::vector<long> _free;	// Slots freed since
+
+	// The live records form a min-heap on (value, then latest in order first), so the one to drop when full is on top.  Results are sorted only once, by InitResIter(), which sorts the heap itself.  Since result order is just the reverse, it then is read from the end.  (A sorted array is still a heap.)
+	std::vector<long> _hp;		// The heap, of slots
+	std::vector<long> _seq;		// Order of each slot's record among those of equal value.  Length GetNumRecAlloc()
+	long _nseq;			// Past the latest order given so far.  Records are ordered by when they were added unless told otherwise.
+	mutable size_t _cii;		// Next to return
+
+	// Spilling.  With no limit on the number of records, once the arena would grow past _ram bytes its records instead are sorted and written out as a run to a scratch file (mapped into memory, so the OS pages it out as it needs).  The arena then is reused.  Reading results merges the runs.
+	long _ram;		// RAM budget for the arena, in bytes.  0 to never spill.
+	std::string _sdir;	// Directory for the scratch file
+	int _fd;		// The scratch file (unlinked as soon as it's created).  -1 if none yet.
+	size_t _flen;		// Its length
+	std::vector<OCollRun> _runs;
+	mutable std::vector<int> _mq;	// Merge heap of the runs with records left, by their next record.  Built by InitResIter().
+	long _nspill;		// Records spilled
 
 	// Configuration
 	int _rsize;		// Record size in bytes (collection + value storage size)
 	int _bsize;		// Number of records per block
 	int _clen;		// Number of items in collection
+	int _iw;		// Bytes per item # unless packed
 	long _maxrec;		// Maximum number of records we retain.  0 if no limit
 	float _ctol;		// Max allowed value is maxval*(1.0-ctol)
 
@@ -53,37 +97,105 @@ protected:
 	long _ncurr;	// Current active entries requests
 	float _maxval;	// Max collection value encountered (NOTE: there may be no existing coll with this if GC removes it later!!!)
 	float _minval;	// Min collection value currently present
+	std::atomic<float> _bar;	// GetBar(), kept up to date as records come and go
+
+	// Duplicate detection.  Collections are the same if they have the same items, in whatever order.
+	bool _dedup;	// Reject duplicates?
+	typedef std::unordered_multimap<uint64_t,long> HMAP;
+	HMAP _h;	// Current records (slots) by the hash of their items
+	int *_ka;	// Scratch for comparing collections.  Length _clen.
+	int *_kb;
+	long _ndup;	// Duplicates rejected
+
+	// Seeds.  Collections added ahead of the search (see OSearch::WarmStart()), which the search then will find again, with the same value since it sums in the same order.  Watching for just these is far cheaper than deduping everything.
+	std::vector<float> _sv;	// Their values
+	std::vector<int> _si;	// Their items, sorted.  _clen per seed.
+
+	// Packing.  If set, records hold the combo chosen at each level instead of the items (see OCollCodec).
+	const OCollCodec *_cd;
+	bool _owncd;		// Do we own _cd?
+
+	// Streaming.  If set, the sink is told of each record as it's added and as it's dropped (see OCollSink).  Not owned.
+	OCollSink *_sink;
+	bool _quiet;		// Merge() is adding records the sink has heard of already
 
-	void addblock(void);		// Add a new block
-	char *droplowest(bool isbad);		// Drop the lowest entry (returning pointer) and update info
+	char *rec(long k) { return &(_a[k*_rsize]); }
+	const char *rec(long k) const { return &(_a[k*_rsize]); }
+	long newslot(void);		// A free slot, growing the arena if need be
+	bool below(long a,long b) const { float va= GetVal(rec(a)), vb= GetVal(rec(b)); return (va<vb||(va==vb&&_seq[a]>_seq[b])); }	// Heap order: does a come out before b?
+	void siftup(long i);
+	void siftdown(long i);
+	long poplowest(void);		// Take the lowest record off the heap (and forget it), returning its slot
 	std::string getstatstr(void) const;		// Return a string of stats
-	void gc(void);		// Unset all entries below minallowed
+	void gc(void);		// Drop all entries below minallowed
+	void setmin(void) { _minval= _hp.empty()?BadVal():GetVal(rec(_hp[0])); }	// Update _minval from the heap
+	void setbar(void);	// Update _bar
+	static uint64_t hashitem(int n);	// Hash of a single item
+	bool samecoll(const char *o,const int *c) const;	// Does record o have the same items as c?
+	void unhash(long k);		// Forget record k (if deduping)
+	void sortheap(int nw);		// Sort the heap (into reverse result order) on nw threads
+	long resslot(size_t i) const { return _hp[_hp.size()-1-i]; }	// Slot of result i, once the heap is sorted
+	long slotsize(void) const { return _rsize+2*sizeof(long); }	// RAM per arena slot, counting its order and place in the heap
+	bool spill(void);		// Write all our records out as a run and empty the arena.  False (and nothing done) if the scratch file can't be grown.
+	float runval(int r,long i) const { float v; memcpy(&v,_runs[r]._p+i*SpillSize()+sizeof(int64_t),sizeof(float)); return v; }
+	int64_t runseq(int r,long i) const { int64_t q; memcpy(&q,_runs[r]._p+i*SpillSize(),sizeof(int64_t)); return q; }
+	const char *runrec(int r,long i) const { return _runs[r]._p+i*SpillSize()+sizeof(int64_t); }	// NOTE: its value may be unaligned, so use runval() rather than GetVal() on it
+	float mergeval(int r) const { return (r<0)?GetVal(rec(resslot(_cii))):runval(r,_runs[r]._i); }	// Value of the next record of run r in the merge.  Run -1 is the sorted heap.
+	int64_t mergeseq(int r) const { return (r<0)?_seq[resslot(_cii)]:runseq(r,_runs[r]._i); }
+	bool spilleddup(uint64_t h,const int *c) const;	// Is c (with hash h) one of the spilled records?
+	const char *nextres(float &v) const;	// The next result and its value (NULL if none left)
+	bool isseed(const int *c,float v) const;	// Is c, with value v, one of the seeds?
+	bool canadd(float v,long seq) const;	// CanAdd() for a record with order seq
+	bool add(bool verbose,int *c,const long *ci,float v,bool *dup,long seq);	// Add() proper, without the mutex.  seq<0 to order by arrival.
 public:
 	// Manage
-	OCollMM(int clen,int bsize,long maxrec,float ctol);
+	OCollMM(int clen,int bsize,long maxrec,float ctol,int iw);	// iw= bytes per item # (OGlobal::ItemWidth() of the number of items)
 	~OCollMM(void);
-	bool Add(bool verbose,int *c,float v);	// Get a coll
+	bool Add(bool verbose,int *c,float v,bool *dup);	// Get a coll.  If rejected as a duplicate, sets *dup (if not NULL).
+	bool Add(bool verbose,int *c,const long *ci,float v,bool *dup,long seq);	// Add(), but with ci the combo chosen at each level, which is all that's stored if packed (otherwise ci may be NULL).  If seq>=0 we order by it (lowest first) among records of equal value rather than by when added.  Of those tied at the bottom when full, the latest in this order give way.  So the records kept don't depend on the order in which they arrive.
+	void Merge(const OCollMM &x);	// Add all of x's records, keeping their order.  x must have the same collection size and mustn't be in use.
+	bool AddSeed(int *c,const long *ci,float v);	// Add c as Add() does, and reject it if it's offered again with the same value
+	bool SetCodec(const OCollCodec *x,bool own);	// Pack records with x (NULL to stop packing).  If own, we delete x when done with it.  False (and nothing changed) if we already hold records.
+	bool IsPacked(void) const { return _cd!=NULL; }
+	const OCollCodec *Codec(void) const { return _cd; }
+	void SetSpill(long ram,const char *dir);	// With no limit on the number of records, spill them to a scratch file in dir (NULL or "" for $TMPDIR or /tmp) once they take more than ram bytes.  0 never spills.  Must be set before anything is added.
+	void SetSink(OCollSink *x);	// Tell x of the records as they come and go (NULL for none).  Must be set before anything is added.
+	OCollSink *Sink(void) const { return _sink; }
+	void SetLocal(bool x);	// If only one thread ever will use us, there's no need to lock.  Must be set before anything is added.
+	void SetDedup(bool x);	// Reject collections with the same items as one we hold.  Only needed when the same items can be reached more than once.  Must be set before anything is added.
 	
 	// Inspect (some of these may be slightly costly
-	long GetNumRec(void) const { return _ncurr; }	// Total number of active records
-	long GetNumRecAlloc(void) const { return _s.size()*_bsize; }	// How many records have been allocated so far
+	long GetNumRec(void) const { return _ncurr; }	// Total number of active records.  Once spilled, this may count some which since fell below GetMinAllowed(), until InitResIter().
+	int ItemWidth(void) const { return _iw; }	// Bytes per item # (unless packed)
+	long GetNumRecAlloc(void) const { return _a.size()/_rsize; }	// How many records have been allocated so far
+	long GetNextSeq(void) const { return _nseq; }	// Past the latest order given so far (see Add())
 	long GetNumReqs(void) const { return _nreqs; }	// Total additions so far (some may have been removed later, though)
+	long GetNumDups(void) const { return _ndup; }	// Total rejected as duplicates
+	long GetNumSpilled(void) const { return _nspill; }	// Total written to the scratch file
+	int GetNumRuns(void) const { return _runs.size(); }
+	long SpillSize(void) const { return sizeof(int64_t)+_rsize; }	// Size of a spilled record
 	float GetMaxVal(void) const { return _maxval; }	// True maxval so far
 	float GetMinVal(void) const { return _minval; }	// Present minval
 	float GetMinAllowed(void) const { return (!IsBadVal(_maxval))?(_maxval*(1.0-_ctol)):BadVal(); }
+	float MinAllowedFor(float v) const { return (!IsBadVal(v))?(v*(1.0-_ctol)):BadVal(); }	// What GetMinAllowed() would be if v were the max.  Only reads config, so safe without the mutex.
 	bool IsFull(void) const { return (_maxrec>0&&_ncurr==_maxrec); }	// Are we full
 	bool CanAdd(float v) const;	// If we try to add a record with value v will we succeed?
+	bool ResBefore(long a,long b) const { float va= GetVal(rec(a)), vb= GetVal(rec(b)); return (va>vb||(va==vb&&_seq[a]<_seq[b])); }	// Does slot a come before slot b in the results?
+	bool RunBefore(int a,int b) const { float va= mergeval(a), vb= mergeval(b); return (va>vb||(va==vb&&mergeseq(a)<mergeseq(b))); }	// In the merge, does the next record of run a come before that of run b?
+	float GetBar(void) const { return _bar.load(std::memory_order_relaxed); }	// Nothing worth less can be added: the greater of GetMinAllowed() and, once full, the lowest value we hold.  Never falls, since gc() only empties slots by raising GetMinAllowed() past what they held.  Safe to read without the mutex.
 
 	// Access results.  NOTE: only can be called after Finalize()!!!!!!
-	void InitResIter(void) { gc(); _cii= _c.begin(); }	// Prepare to read results from start.  MUST be called after all items have been added and before any call to GetRes()!
-	int GetRes(int n,unsigned int **r,float *m) const;	 // Populate the necessary arrays with the next (up to) n results.  n is the size of r,m (which must be >=iend-istart or we reduce iend to istart+n).  We return the results from where we left off (or the start if first call after InitResIter(), and in descending order of value. For a fixed value, result order is not stable.  
+	void InitResIter(int nw=1);	// Prepare to read results from start, sorting them on nw threads.  MUST be called after all items have been added and before any call to GetRes()!
+	int GetRes(int n,unsigned int **r,float *m) const;	 // Populate the necessary arrays with the next (up to) n results.  n is the size of r,m (which must be >=iend-istart or we reduce iend to istart+n).  We return the results from where we left off (or the start if first call after InitResIter(), and in descending order of value.  For a fixed value, the earliest added come first.  
+	long GetResFlat(long n,unsigned int *r,float *m,bool sorted) const;	// GetRes(), but r is a single n x collection size array, row by row.  If sorted, each row's items are in ascending order rather than by slot.
+	const char *ResView(long *n,int *rsize);	// Lay out the results in the arena in result order, for reading in place, and return it.  That's *n records of *rsize bytes: the value (a float), then the collection size item #s of ItemWidth() bytes each.  Neither need be aligned.  NULL if packed, spilled or empty.  Call after InitResIter(); good until anything else is added or InitResIter() is called again.  Restarts GetRes().
 	std::string GetStatStr(void) const;		// Return a string of stats
 
 	// Access an individual record
 	float GetVal(const char *o) const { return o?(*((float *)(o))):BadVal(); }	// Return the value, or BadVal() if error
 	void SetVal(char *o,float v) const { if (o) *((float *)(o))= v; }
-	int GetItem(const char *o,int i) const { return o?int(*((int16_t *)(o+sizeof(float)+sizeof(int16_t)*i))):-1; }	// Return item i or -1 if error. 
-	void SetItem(char *o,int i,int n) const { if (o&&i>=0&&i<_clen&&n>=0&&n<32767) *((int16_t *)(o+sizeof(float)+sizeof(int16_t)*i))= (int16_t)n; }	// Set item i to n
+	int GetItem(const char *o,int i) const { return o?(_cd?_cd->Item(o+sizeof(float),i):GetItemAt(o+sizeof(float),_iw,i)):-1; }	// Return item i or -1 if error. 
+	void SetItem(char *o,int i,int n) const { if (o&&!_cd&&i>=0&&i<_clen&&n>=0&&(_iw==4||n<(1<<(8*_iw)))) SetItemAt(o+sizeof(float),_iw,i,n); }	// Set item i to n.  Not if packed, or if n won't fit.
 	std::string GetStr(const char *o,bool justints) const;	// Display string.  If justints, only displays list of items
 	bool IsUnset(const char *o) const { return (!o||IsBadVal(GetVal(o))); }
 	void Unset(char *o) const { SetVal(o,BadVal()); }
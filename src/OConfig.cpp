@@ -7,8 +7,10 @@
 #include "OFeature.h"
 #include "OCFN.h"
 #include "OColl.h"
+#include "OSink.h"
+#include "OBestFirst.h"
 
-OConfig::OConfig(void) : OMtxCtlBase(), _nf(0), _f(NULL), _pfnum(0), _pf(NULL), _pfn(NULL), _maxcost(0), _cfn(NULL), _numcfn(0), _ni(0), _ic(NULL), _iv(NULL), _ctol(-1), _itol(-1), _ntol(0), _resnumb(0), _maxres(0), _smode(1), _maxcosttol(0.01), _res(NULL) {}
+OConfig::OConfig(void) : OMtxCtlBase(), _nf(0), _f(NULL), _pfnum(0), _pf(NULL), _pfn(NULL), _maxcost(0), _cfn(NULL), _numcfn(0), _fused(NULL), _ni(0), _ic(NULL), _iv(NULL), _ctol(-1), _itol(-1), _ntol(0), _resnumb(0), _maxres(0), _smode(1), _maxcosttol(0.01), _nthreads(1), _bmode(0), _nbins(1000), _gtol(-1), _gntol(0), _maxcombos(0), _tlim(0), _maxanal(0), _cancel(false), _stopwhy(0), _coverage(0), _plorder(NULL), _plbycost(NULL), _tunenodes(0), _nseed(0), _scalar(false), _spillmb(0), _spilldir(), _packres(false), _sink(NULL), _uorder(NULL), _ubycost(NULL), _res(NULL), _bf(NULL) {}
 
 OConfig::~OConfig(void)
 {
@@ -42,7 +44,9 @@ bool OConfig::Init(int nf,int pf,int *pfn,int pfnn,int ni,float mc,int nc)
 
 	// Create res
 	if (_res) delete _res;
-	_res= new OCollMM(_cs,_resnumb,_maxres,_ctol);
+	_res= new OCollMM(_cs,_resnumb,_maxres,_ctol,ItemWidth());
+	_res->SetSpill(SpillRAM(),SpillDir());
+	_res->SetSink(_sink);
 
 	return true;
 }
@@ -59,12 +63,20 @@ bool OConfig::IsSensible(bool ctoo) const
 		if (_pfn[i]<0) return false;
 	if (_maxcost<0) return false;
 	if (_ni<=0) return false;
-	if (_ni>32767) return false;	// Since we need to be able to wedge into int16_t at some point
 	if (!_ic) return false;
 	if (!_iv) return false;
 	if (_resnumb<=0) return false;
 	if (_maxres<0) return false;
 	if (_smode<1||_smode>4) return false;
+	if (_nthreads<1) return false;
+	if (_bmode<0||_bmode>1) return false;
+	if (_bmode>0&&_nbins<1) return false;
+	if (_gntol<0) return false;
+	if (_maxcombos<0) return false;
+	if (_tlim<0) return false;
+	if (_maxanal<0) return false;
+	if (_tunenodes<0) return false;
+	if (_nseed<0) return false;
 	if (_ctol<0) return false;
 	if (_itol<0) return false;
 	if (_ntol<0) return false;
@@ -121,6 +133,13 @@ bool OConfig::InitConstraints(void)
 			if (!_cfn[i]->Init()) rc= false;
 		}
 	}
+	delete _fused;
+	_fused= new OCFNFused;
+	if (!rc||!_fused->Build(this,_cfn,_numcfn))
+	{
+		delete _fused;
+		_fused= NULL;
+	}
 	return rc;
 }
 
@@ -174,13 +193,14 @@ int OConfig::TestConstraints(const int *x) const
 {
 	// NO mutex protection here!!
 	if (!x) return -1;
+	if (_fused) return _fused->Test(x);
 	for (int i=0;i<_numcfn;++i)
 		if (_cfn[i]&&!_cfn[i]->Test(x)) 
 			return i;
 	return -1;
 }
 
-void OConfig::InitParms(float ctol,float itol,int ntol,int resnumb,long maxres,int smode)
+void OConfig::InitParms(float ctol,float itol,int ntol,int resnumb,long maxres,int smode,int nthreads)
 {
 	OConfigMtxCtl mtx(this);
 	_ctol= ctol;
@@ -189,6 +209,7 @@ void OConfig::InitParms(float ctol,float itol,int ntol,int resnumb,long maxres,i
 	_resnumb= resnumb;
 	_maxres= maxres;
 	_smode= smode;
+	_nthreads= nthreads;
 }
 
 /*
@@ -275,6 +296,8 @@ void OConfig::Clear(void)
 	_pf= NULL;
 	_cs= 0;
 	_maxcost= 0;
+	delete _fused;
+	_fused= NULL;
 	for (int i=0;i<_numcfn;++i) delete _cfn[i];
 	delete [] _cfn;
 	_cfn= NULL;
@@ -290,15 +313,133 @@ void OConfig::Clear(void)
 	_resnumb= 0;
 	_maxres= 0;
 	_smode= 1;
+	_nthreads= 1;
+	_bmode= 0;
+	_nbins= 1000;
+	_gtol= -1;
+	_gntol= 0;
+	_maxcombos= 0;
+	_tlim= 0;
+	_maxanal= 0;
+	_cancel.store(false);
+	_stopwhy= 0;
+	_coverage= 0;
+	delete [] _plorder;
+	_plorder= NULL;
+	delete [] _plbycost;
+	_plbycost= NULL;
+	_tunenodes= 0;
+	_nseed= 0;
+	_scalar= false;
+	_spillmb= 0;
+	_spilldir= "";
+	_packres= false;
+	delete [] _uorder;
+	_uorder= NULL;
+	delete [] _ubycost;
+	_ubycost= NULL;
 	if (_res) delete _res;
 	_res= NULL;
+	delete _sink;
+	_sink= NULL;
+	delete _bf;
+	_bf= NULL;
 }
 
 void OConfig::ResetResults(void)
 {
 	OConfigMtxCtl mtx(this);
 	if (_res) delete _res;
-	_res= new OCollMM(_cs,_resnumb,_maxres,_ctol);
+	if (_sink) _sink->Clear();
+	_res= new OCollMM(_cs,_resnumb,_maxres,_ctol,ItemWidth());
+	_res->SetSpill(SpillRAM(),SpillDir());
+	_res->SetSink(_sink);
+	delete _bf;
+	_bf= NULL;
+	_cancel.store(false);
+	_stopwhy= 0;
+	_coverage= 0;
+}
+
+bool OConfig::SetSearchPlan(const int *order,const int *bycost)
+{
+	OConfigMtxCtl mtx(this);
+	int ng= NumPrimaryGroups();
+	if (ng<=0) return false;
+	if (order)
+	{
+		std::vector<bool> seen(ng,false);
+		for (int l=0;l<ng;++l)
+		{
+			if (order[l]<0||order[l]>=ng||seen[order[l]]) return false;
+			seen[order[l]]= true;
+		}
+	}
+	delete [] _plorder;
+	_plorder= NULL;
+	delete [] _plbycost;
+	_plbycost= NULL;
+	if (order)
+	{
+		_plorder= new int [ng];
+		for (int l=0;l<ng;++l) _plorder[l]= order[l];
+	}
+	if (bycost)
+	{
+		_plbycost= new bool [ng];
+		for (int g=0;g<ng;++g) _plbycost[g]= (bycost[g]!=0);
+	}
+	return true;
+}
+
+void OConfig::SetSpill(long mb,const char *dir)
+{
+	OConfigMtxCtl mtx(this);
+	_spillmb= (mb>0)?mb:0;
+	_spilldir= (dir)?dir:"";
+	if (_res) _res->SetSpill(SpillRAM(),SpillDir());
+}
+
+void OConfig::SetSink(OCollSink *x)
+{
+	OConfigMtxCtl mtx(this);
+	if (_res) _res->SetSink(x);
+	delete _sink;
+	_sink= x;
+}
+
+void OConfig::SetUsedPlan(const int *order,const bool *bycost) const
+{
+	OConfigMtxCtl mtx(this);
+	int ng= NumPrimaryGroups();
+	if (ng<=0) return;
+	if (!_uorder) _uorder= new int [ng];
+	if (!_ubycost) _ubycost= new bool [ng];
+	for (int i=0;i<ng;++i)
+	{
+		_uorder[i]= order[i];
+		_ubycost[i]= bycost[i];
+	}
+}
+
+int OConfig::GetUsedPlan(int *order,int *bycost) const
+{
+	OConfigMtxCtl mtx(this);
+	if (!_uorder||!_ubycost) return 0;
+	int ng= NumPrimaryGroups();
+	for (int i=0;i<ng;++i)
+	{
+		if (order) order[i]= _uorder[i];
+		if (bycost) bycost[i]= _ubycost[i]?1:0;
+	}
+	return ng;
+}
+
+void OConfig::SetBestFirst(OBestFirst *b) const
+{
+	OConfigMtxCtl mtx(this);
+	if (_bf!=b) delete _bf;
+	_bf= b;
 }
 
 void OConfig::DumpItems(FILE *f) const
@@ -344,6 +485,7 @@ void OConfig::DumpConfig(FILE *f) const
 	fprintf(f,"%20s : %10d\n","CollectionSize",_cs);
 	fprintf(f,"%20s : %10d\n","NumItems",_ni);
 	fprintf(f,"%20s : %10d\n","NumConstraints",_numcfn);
+	fprintf(f,"%20s : %10d\n","FusedConstraints",_fused?_fused->NumFused():0);
 	for (int i=0;i<_numcfn;++i)
 		fprintf(f,"Constraint%d : %s\n",i+1,_cfn[i]->Desc().c_str());
 
@@ -355,6 +497,27 @@ void OConfig::DumpConfig(FILE *f) const
 	fprintf(f,"%20s : %d\n","resnumb",_resnumb);
 	fprintf(f,"%20s : %ld\n","maxres",_maxres);
 	fprintf(f,"%20s : %d\n","smode",_smode);
+	fprintf(f,"%20s : %d\n","nthreads",_nthreads);
+	fprintf(f,"%20s : %d\n","bmode",_bmode);
+	fprintf(f,"%20s : %d\n","nbins",_nbins);
+	fprintf(f,"%20s : %f\n","gtol",_gtol);
+	fprintf(f,"%20s : %d\n","gntol",_gntol);
+	fprintf(f,"%20s : %ld\n","maxcombos",_maxcombos);
+	fprintf(f,"%20s : %f\n","tlim",_tlim);
+	fprintf(f,"%20s : %ld\n","maxanal",_maxanal);
+	fprintf(f,"%20s : ","PlanOrder");
+	for (int i=0;_plorder&&i<_pf->NumGroups();++i) fprintf(f,"%s%d",(i>0)?":":"",_plorder[i]);
+	fprintf(f,"%s\n",_plorder?"":"smode");
+	fprintf(f,"%20s : ","PlanByCost");
+	for (int i=0;_plbycost&&i<_pf->NumGroups();++i) fprintf(f,"%s%d",(i>0)?":":"",_plbycost[i]?1:0);
+	fprintf(f,"%s\n",_plbycost?"":"smode");
+	fprintf(f,"%20s : %ld\n","tunenodes",_tunenodes);
+	fprintf(f,"%20s : %d\n","nseed",_nseed);
+	fprintf(f,"%20s : %d\n","scalar",_scalar?1:0);
+	fprintf(f,"%20s : %ld\n","spillmb",_spillmb);
+	fprintf(f,"%20s : %s\n","spilldir",_spilldir.c_str());
+	fprintf(f,"%20s : %d\n","packres",_packres?1:0);
+	fprintf(f,"%20s : %d\n","sink",_sink?1:0);
 }
 
 
@@ -2,9 +2,11 @@
 #define OCONFIGDEFFLAG
 
 #include <list>
+#include <string>
 #include <stdio.h>
 #include <math.h>
 #include <inttypes.h>
+#include <atomic>
 #include "OFeature.h"
 #include "OMutex.h"
 #include "OGlobal.h"
@@ -12,6 +14,9 @@
 class OCFN;
 class OFeature;
 class OCollMM;
+class OCollSink;
+class OCFNFused;
+class OBestFirst;
 
 // Main configuration class.
 class OConfig : public OMtxCtlBase, public OGlobal
@@ -36,6 +41,7 @@ protected:
 	// Ancillary constraints
 	OCFN **_cfn;	// Contraint functions
 	int _numcfn;	// Number of constraint functions
+	OCFNFused *_fused;	// The built-in ones, compiled to be tested together.  Built by InitConstraints().  NULL if none.
 
 	// Item info
 	int _ni;	// Number of items
@@ -50,9 +56,32 @@ protected:
 	long _maxres;	// Maximum number of results to allow in MM (more triggers a special GC).  0 means ignore.  
 	int _smode;	// 1= Descending Perf/small-to-large groups, 2= Desc Perf/large-to-small, 3= Asc Cost/small-to-large, 4= Asc Cost/large-to-small.  Best to worst:  1, 2, 3, 4.  
 	float _maxcosttol;	// Used for integer and near-integer cost values.   Shouldn't need adjusting unless costs are floats.
+	int _nthreads;	// Number of search threads.  1= serial search.
+	int _bmode;	// Search bound mode.  0= classic (best values and lowest costs of remaining groups), 1= budget tables
+	int _nbins;	// Number of cost bins for the budget tables
+	float _gtol;	// Combo tolerance.  Like _itol but for the combos of each primary group.  <0 means no combo cull.
+	int _gntol;	// Number of extra combos to require in the combo cull
+	long _maxcombos;	// Most combos to keep for each primary group (the best, in scan order).  0 means no limit.
+	double _tlim;	// Time limit for the search in seconds.  0 means none.
+	long _maxanal;	// Limit on the number of collections analyzed.  0 means none.
+	mutable std::atomic<bool> _cancel;	// Set (from any thread) to stop the search
+	mutable int _stopwhy;	// Why the last search stopped early (0 if it didn't).  See OSearch::StopReason().
+	mutable double _coverage;	// Fraction of the state space the last search covered
+	int *_plorder;	// Search plan: the primary group searched at each level.  Length NumPrimaryGroups().  NULL to order by _smode.
+	bool *_plbycost;	// Search plan: whether to scan each primary group by ascending cost (otherwise descending value).  Length NumPrimaryGroups().  NULL to follow _smode.
+	long _tunenodes;	// Auto-tune the plan with probe searches of this many combos each.  0 means don't.
+	int _nseed;	// Number of warm start collections to try to seed the search with.  0 means don't.
+	bool _scalar;	// Scan runs of combos with the plain loop rather than the widest block kernel the CPU supports
+	long _spillmb;	// With no maxres, spill the results to disk once they take this many MB.  0 means never.
+	std::string _spilldir;	// Where to spill them.  "" for $TMPDIR or /tmp.
+	bool _packres;	// Store each result as the combo chosen for each primary group rather than its items
+	OCollSink *_sink;	// Told of the results as the search finds them.  Owned.  NULL for none.
+	mutable int *_uorder;	// The plan the last search actually used.  NULL if none yet.
+	mutable bool *_ubycost;
 
 	// Results
 	mutable OCollMM *_res;
+	mutable OBestFirst *_bf;	// Best-first result cursor (if one has been started)
 public:
 	// Management
 	OConfig(void);
@@ -64,9 +93,45 @@ public:
 	bool InitItems(float *c,float *m);
 	bool SetConstraint(int cn,OCFN *c);	// We take ownership of c
 	bool InitConstraints(void);	// Resets and inits constraints
-	void InitParms(float ctol,float itol,int ntol,int resnumb,long maxres,int smode);
+	void InitParms(float ctol,float itol,int ntol,int resnumb,long maxres,int smode,int nthreads);
 	void SetMaxCostTol(float x) { _maxcosttol= (x>0?x:0); }
 	float MaxCostTol(void) const { return _maxcosttol; }
+	void SetBoundMode(int m,int nb) { _bmode= m; _nbins= nb; }
+	int BoundMode(void) const { return _bmode; }
+	int BoundBins(void) const { return _nbins; }
+	void SetComboCull(float gtol,int gntol) { _gtol= gtol; _gntol= gntol; }
+	float ComboTol(void) const { return _gtol; }
+	int ComboNTol(void) const { return _gntol; }
+	void SetMaxCombos(long n) { _maxcombos= n; }
+	long MaxCombos(void) const { return _maxcombos; }
+	void SetLimits(double tlim,long maxanal) { _tlim= tlim; _maxanal= maxanal; }
+	double TimeLimit(void) const { return _tlim; }
+	long MaxAnalyzed(void) const { return _maxanal; }
+	void Cancel(void) const { _cancel.store(true); }	// Safe to call from any thread or a signal handler
+	void ClearCancel(void) const { _cancel.store(false); }
+	bool IsCancelled(void) const { return _cancel.load(); }
+	const std::atomic<bool> *CancelToken(void) const { return &_cancel; }
+	void SetSearchStatus(int why,double cov) const { _stopwhy= why; _coverage= cov; }
+	int StopReason(void) const { return _stopwhy; }
+	double Coverage(void) const { return _coverage; }
+	bool SetSearchPlan(const int *order,const int *bycost);	// order[l] is the primary group to search at level l, bycost[g] nonzero to scan group g by cost.  Either may be NULL to follow smode instead.  False (and nothing set) if order isn't a permutation of the primary groups.
+	const int *PlanOrder(void) const { return _plorder; }
+	const bool *PlanByCost(void) const { return _plbycost; }
+	void SetAutoTune(long probenodes) { _tunenodes= probenodes; }
+	long AutoTuneNodes(void) const { return _tunenodes; }
+	void SetWarmStart(int n) { _nseed= n; }
+	int WarmStarts(void) const { return _nseed; }
+	void SetScalarKernel(bool x) { _scalar= x; }
+	bool ScalarKernel(void) const { return _scalar; }
+	void SetSpill(long mb,const char *dir);
+	long SpillRAM(void) const { return _spillmb<<20; }	// In bytes
+	const char *SpillDir(void) const { return _spilldir.c_str(); }
+	void SetPackedResults(bool x) { _packres= x; }
+	bool PackedResults(void) const { return _packres; }
+	void SetSink(OCollSink *x);	// Stream the results to x (which we take over), or stop if NULL
+	OCollSink *Sink(void) const { return _sink; }
+	void SetUsedPlan(const int *order,const bool *bycost) const;	// Record the plan a search used
+	int GetUsedPlan(int *order,int *bycost) const;		// Fill in the plan the last search used, as for SetSearchPlan().  Returns the number of levels, or 0 if there's been no search.
 	
 	// Excluding items from groups and overall [Used by individual cull function]
 	void PrepToExclude(int i,int j);	// j is group of primary feature.  If -1, exclude overall
@@ -74,6 +139,7 @@ public:
 
 	// Simple accessors
 	int NumItems(void) const { return _ni; }
+	int ItemWidth(void) const { return OGlobal::ItemWidth(_ni); }	// Bytes the results and search plan use per item #
 	const OFeature *AccessFeature(int n) const;
 	const OFeature *AccessPrimaryFeature(void) const { return _pf; }
 	int NumFeatures(void) const { return _nf; }
@@ -84,7 +150,12 @@ public:
 	float CTol(void) const { return _ctol; }
 	bool IsSearchByCost(void) const { return (_smode==3||_smode==4); }
 	bool IsGroupLowToHigh(void) const { return (_smode==1||_smode==3); }
+	int NumThreads(void) const { return _nthreads; }
+	int ResNumb(void) const { return _resnumb; }
+	long MaxRes(void) const { return _maxres; }
 	OCollMM *AccessMM(void) const { return _res; }
+	OBestFirst *AccessBestFirst(void) const { return _bf; }
+	void SetBestFirst(OBestFirst *b) const;		// We take ownership of b (replacing any existing cursor)
 
 	// Value functions.  i is the item.  Returns 
 	float *Vals(void) const { return _iv; }				// List of values in item order
@@ -95,7 +166,7 @@ public:
 
 	// Other useful
 	int CollectionSize(void) const { return _cs; }	// Number of items in a collection. -1 if error
-	int TestConstraints(const int *x) const;	// Test a collection against all constraints.  -1 if satisfies all constraints.  Otherwise returns the 1st constraint number violated (starting at 0).  NOT mutex-protected, so be careful with any late-stage modifications.  Too expensive to mutex this!  And unnecessary.
+	int TestConstraints(const int *x) const;	// Test a collection against all constraints.  -1 if satisfies all constraints.  Otherwise returns the 1st constraint number violated (starting at 0).  NOT mutex-protected, so be careful with any late-stage modifications.  Too expensive to mutex this!  And unnecessary.  Called concurrently by the parallel search.
 	int NumConstraints(void) const { return _numcfn; }
 
 	// Cull Players which fail individual tol test.  Returns number culled.  Note that ni is unchanged.  The culling is done in the primary feature (and all derived arrays).  The returned value only counts those not already culled.
@@ -2,6 +2,8 @@
 #define OGLOBALDEFFLAG
 
 #include <math.h>
+#include <stdlib.h>
+#include <inttypes.h>
 
 // Just useful static values
 class OGlobal
@@ -11,6 +13,10 @@ public:
 	static float BadVal(void) { return -999999; }
 	static bool IsBadCost(float c) { return (fabs(c-BadCost())<0.01); }
 	static bool IsBadVal(float v) { return (fabs(v-BadVal())<0.01); }	
+	static int ItemWidth(long ni) { return (ni<=256)?1:((ni<=65536)?2:4); }	// Bytes needed for an item # (0 to ni-1)
+	static int GetItemAt(const void *p,int w,long i) { return (w==1)?int(((const uint8_t *)p)[i]):((w==2)?int(((const uint16_t *)p)[i]):((const int32_t *)p)[i]); }	// Item i of an array of items w bytes wide
+	static void SetItemAt(void *p,int w,long i,int n) { if (w==1) ((uint8_t *)p)[i]= (uint8_t)n; else if (w==2) ((uint16_t *)p)[i]= (uint16_t)n; else ((int32_t *)p)[i]= n; }
+	template <class T> static T *AlignedNew(long n) { void *p= NULL; if (n<=0||posix_memalign(&p,64,n*sizeof(T))!=0) return NULL; return (T *)p; }	// Cache line aligned array of n (uninitialized).  Release with free().  NULL if n<=0 or out of memory.
 };
 
 
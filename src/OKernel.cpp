@@ -0,0 +1,97 @@
+#include "OKernel.h"
+
+#if defined(__x86_64__)||defined(__i386__)
+#include <immintrin.h>
+#define OKERNX86
+#endif
+
+//////// Plain loops
+
+static long cheapscalar(const float *c,long i,long e,float mrc,float lim)
+{
+	for (;i<e;++i)
+		if (!(c[i]+mrc>lim)) return i;
+	return e;
+}
+
+static long goodscalar(const float *v,long i,long e,float mrv,float val,float mv)
+{
+	for (;i<e;++i)
+		if (!(v[i]+mrv+val<mv)) return i;
+	return e;
+}
+
+static const OKernel okscalar= { "scalar", 8, cheapscalar, goodscalar };
+
+#ifdef OKERNX86
+
+//////// SSE.  The ordered compares are false on NaN, as the scalar tests are.
+
+__attribute__((target("sse2"))) static long cheapsse(const float *c,long i,long e,float mrc,float lim)
+{
+	__m128 a= _mm_set1_ps(mrc);
+	__m128 l= _mm_set1_ps(lim);
+	for (;i+4<=e;i+=4)
+	{
+		int m= _mm_movemask_ps(_mm_cmpgt_ps(_mm_add_ps(_mm_loadu_ps(c+i),a),l));	// Lanes which fail
+		if (m!=0xf) return i+__builtin_ctz(~m);
+	}
+	return cheapscalar(c,i,e,mrc,lim);
+}
+
+__attribute__((target("sse2"))) static long goodsse(const float *v,long i,long e,float mrv,float val,float mv)
+{
+	__m128 a= _mm_set1_ps(mrv);
+	__m128 b= _mm_set1_ps(val);
+	__m128 l= _mm_set1_ps(mv);
+	for (;i+4<=e;i+=4)
+	{
+		int m= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(_mm_add_ps(_mm_loadu_ps(v+i),a),b),l));
+		if (m!=0xf) return i+__builtin_ctz(~m);
+	}
+	return goodscalar(v,i,e,mrv,val,mv);
+}
+
+static const OKernel oksse= { "sse2", 16, cheapsse, goodsse };
+
+//////// AVX2
+
+__attribute__((target("avx2"))) static long cheapavx2(const float *c,long i,long e,float mrc,float lim)
+{
+	__m256 a= _mm256_set1_ps(mrc);
+	__m256 l= _mm256_set1_ps(lim);
+	for (;i+8<=e;i+=8)
+	{
+		int m= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(_mm256_loadu_ps(c+i),a),l,_CMP_GT_OQ));
+		if (m!=0xff) return i+__builtin_ctz(~m);
+	}
+	return cheapscalar(c,i,e,mrc,lim);
+}
+
+__attribute__((target("avx2"))) static long goodavx2(const float *v,long i,long e,float mrv,float val,float mv)
+{
+	__m256 a= _mm256_set1_ps(mrv);
+	__m256 b= _mm256_set1_ps(val);
+	__m256 l= _mm256_set1_ps(mv);
+	for (;i+8<=e;i+=8)
+	{
+		int m= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(v+i),a),b),l,_CMP_LT_OQ));
+		if (m!=0xff) return i+__builtin_ctz(~m);
+	}
+	return goodscalar(v,i,e,mrv,val,mv);
+}
+
+static const OKernel okavx2= { "avx2", 16, cheapavx2, goodavx2 };
+
+#endif
+
+const OKernel *OKernel::Pick(bool scalar)
+{
+	if (scalar) return &okscalar;
+#ifdef OKERNX86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return &okavx2;
+	if (__builtin_cpu_supports("sse2")) return &oksse;
+#endif
+	return &okscalar;
+}
@@ -0,0 +1,20 @@
+#ifndef OKERNELDEFFLAG
+#define OKERNELDEFFLAG
+
+/* Block scans for the search's skips.
+
+Most of the search's time goes to the last level, scanning runs of combos which fail the cheap cost or value test on the way to the next one worth a closer look.  A kernel tests a block of combos at once and returns the first which passes, so only those go on to the dup, symmetry and constraint tests.  Each test is phrased exactly as the search phrases it (the sums are formed in the same order, in single precision), so every kernel returns exactly what the plain loop does.
+
+The widest kernel the CPU supports is chosen at runtime.  The plain loop can be forced instead (see OConfig::SetScalarKernel()), to check one against the other.
+*/
+struct OKernel
+{
+	const char *_name;
+	long _scan;		// How far to scan a run before resorting to the range index
+	long (*_cheap)(const float *c,long i,long e,float mrc,float lim);		// First j in [i,e) with !(c[j]+mrc>lim), or e
+	long (*_good)(const float *v,long i,long e,float mrv,float val,float mv);	// First j in [i,e) with !(v[j]+mrv+val<mv), or e
+
+	static const OKernel *Pick(bool scalar);	// The widest the CPU supports, or the plain loop if scalar
+};
+
+#endif
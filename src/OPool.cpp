@@ -0,0 +1,116 @@
+#include <vector>
+#include <pthread.h>
+#include "OPool.h"
+
+// What we hand to each spawned thread
+struct OWArg
+{
+	OWorkPool *_p;
+	int _w;
+};
+
+OWorkPool::OWorkPool(int nw) : _nw(nw>0?nw:1), _wq(NULL), _job(NULL), _nsteal(NULL)
+{
+	_wq= new OWQueue [_nw];
+	_nsteal= new long [_nw];
+	for (int i=0;i<_nw;++i) _nsteal[i]= 0;
+}
+
+OWorkPool::~OWorkPool(void)
+{
+	delete [] _wq;
+	delete [] _nsteal;
+}
+
+bool OWorkPool::pop(int w,long &t)
+{
+	OWQueue &q= _wq[w];
+	q._mtx.Lock();
+	bool rc= !q._q.empty();
+	if (rc)
+	{
+		t= q._q.front();
+		q._q.pop_front();
+	}
+	q._mtx.UnLock();
+	return rc;
+}
+
+bool OWorkPool::steal(int w,long &t)
+{
+	for (int k=1;k<_nw;++k)
+	{
+		OWQueue &q= _wq[(w+k)%_nw];
+		q._mtx.Lock();
+		bool rc= !q._q.empty();
+		if (rc)
+		{
+			t= q._q.back();
+			q._q.pop_back();
+		}
+		q._mtx.UnLock();
+		if (rc)
+		{
+			_nsteal[w]++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void OWorkPool::work(int w)
+{
+	long t;
+	while (pop(w,t)||steal(w,t))
+		_job->Run(w,t);
+}
+
+void *OWorkPool::thread_start(void *p)
+{
+	OWArg *a= (OWArg *)p;
+	a->_p->work(a->_w);
+	return NULL;
+}
+
+bool OWorkPool::Run(OPoolJob &j,long nt)
+{
+	if (nt<=0) return true;
+	_job= &j;
+
+	// Deal out the tasks in contiguous chunks so that neighboring tasks start on the same worker
+	for (int w=0;w<_nw;++w)
+	{
+		_nsteal[w]= 0;
+		_wq[w]._q.clear();
+		long s= (nt*w)/_nw;
+		long e= (nt*(w+1))/_nw;
+		for (long t=s;t<e;++t) _wq[w]._q.push_back(t);
+	}
+
+	// Start the helpers.  If one won't start, the rest just pick up its share.
+	std::vector<pthread_t> th(_nw);
+	std::vector<OWArg> args(_nw);
+	std::vector<bool> started(_nw,false);
+	bool rc= true;
+	for (int w=1;w<_nw;++w)
+	{
+		args[w]._p= this;
+		args[w]._w= w;
+		if (pthread_create(&(th[w]),NULL,thread_start,&(args[w]))==0) started[w]= true;
+		else rc= false;
+	}
+
+	// We are worker 0
+	work(0);
+	for (int w=1;w<_nw;++w)
+		if (started[w]) pthread_join(th[w],NULL);
+	_job= NULL;
+	return rc;
+}
+
+long OWorkPool::NumStolen(void) const
+{
+	long n= 0;
+	for (int w=0;w<_nw;++w) n+= _nsteal[w];
+	return n;
+}
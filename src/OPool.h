@@ -0,0 +1,48 @@
+#ifndef OPOOLDEFFLAG
+#define OPOOLDEFFLAG
+
+#include <deque>
+#include "OMutex.h"
+
+//! Functionoid for the work handed to OWorkPool.  Run() is called once for every task number, on whichever worker happens to pick it up.  It must be safe to call concurrently for different tasks.
+class OPoolJob
+{
+public:
+	virtual ~OPoolJob(void) {}
+	virtual void Run(int w,long t)=0;	// Perform task t on worker w (0..NumWorkers()-1)
+};
+
+/* Simple work-stealing pool.
+
+The tasks for a job are numbered 0..nt-1 and dealt out to the workers in contiguous chunks.  Each worker pops from the front of its own queue and, once empty, steals from the back of the others.  Because tasks never spawn new tasks, a worker which finds every queue empty is done.  Worker 0 is the calling thread, so a 1-worker pool never creates a thread.
+*/
+class OWorkPool
+{
+private:
+	OWorkPool(const OWorkPool &x) {}
+protected:
+	// A single worker queue
+	struct OWQueue
+	{
+		OMutex _mtx;
+		std::deque<long> _q;
+	};
+
+	int _nw;		// Number of workers
+	OWQueue *_wq;		// Length _nw
+	OPoolJob *_job;		// Job currently being run.  Not owned.
+	long *_nsteal;		// Tasks stolen by each worker.  Length _nw (diagnostic)
+
+	bool pop(int w,long &t);	// Pop from our own queue
+	bool steal(int w,long &t);	// Steal from the back of somebody else's
+	void work(int w);		// Worker loop
+	static void *thread_start(void *p);
+public:
+	OWorkPool(int nw);
+	~OWorkPool(void);
+	int NumWorkers(void) const { return _nw; }
+	bool Run(OPoolJob &j,long nt);		// Run tasks [0,nt) and return once all are complete.  False if some helper threads failed to start (the tasks still all are run by those which did)
+	long NumStolen(void) const;		// Tasks stolen during the last Run()
+};
+
+#endif
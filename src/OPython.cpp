@@ -1,3 +1,4 @@
+#include <signal.h>
 #include "OPython.h"
 #include "OConfig.h"
 #include "OAPI.h"
@@ -13,9 +14,9 @@ void kopt_init_struct(int nf,int pf,int *pfn,int pfnn,int ni,float mc,int nc)
 	kopt_init_struct_ts(AC(),nf,pf,pfn,pfnn,ni,mc,nc);
 }
 
-void kopt_init_parms(float ctol,float itol,int ntol,int resnumb,long maxres,int smode)
+void kopt_init_parms(float ctol,float itol,int ntol,int resnumb,long maxres,int smode,int nthreads)
 {
-	kopt_init_parms_ts(AC(),ctol,itol,ntol,resnumb,maxres,smode);
+	kopt_init_parms_ts(AC(),ctol,itol,ntol,resnumb,maxres,smode,nthreads);
 }
 
 void kopt_init_feature(int fn,int ng,int ni,int ispart,int **f)
@@ -38,6 +39,86 @@ void kopt_set_maxcosttol(float x)
 	kopt_set_maxcosttol_ts(AC(),x);
 }
 
+void kopt_set_bound_mode(int bmode,int nbins)
+{
+	kopt_set_bound_mode_ts(AC(),bmode,nbins);
+}
+
+void kopt_set_combo_cull(float gtol,int gntol)
+{
+	kopt_set_combo_cull_ts(AC(),gtol,gntol);
+}
+
+void kopt_set_combo_cap(long maxcombos)
+{
+	kopt_set_combo_cap_ts(AC(),maxcombos);
+}
+
+int kopt_set_plan(int *order,int *bycost)
+{
+	return kopt_set_plan_ts(AC(),order,bycost);
+}
+
+void kopt_set_autotune(long probenodes)
+{
+	kopt_set_autotune_ts(AC(),probenodes);
+}
+
+int kopt_get_plan(int *order,int *bycost)
+{
+	return kopt_get_plan_ts(AC(),order,bycost);
+}
+
+void kopt_set_warmstart(int nseed)
+{
+	kopt_set_warmstart_ts(AC(),nseed);
+}
+
+void kopt_set_scalar(int scalar)
+{
+	kopt_set_scalar_ts(AC(),scalar);
+}
+
+void kopt_set_spill(long rammb,const char *dir)
+{
+	kopt_set_spill_ts(AC(),rammb,dir);
+}
+
+void kopt_set_packed(int packed)
+{
+	kopt_set_packed_ts(AC(),packed);
+}
+
+int kopt_set_sink_file(const char *path,int text)
+{
+	return kopt_set_sink_file_ts(AC(),path,text);
+}
+
+int kopt_set_sink_pipe(const char *cmd,int text)
+{
+	return kopt_set_sink_pipe_ts(AC(),cmd,text);
+}
+
+void kopt_set_sink_callback(OCollSinkFn fn)
+{
+	kopt_set_sink_callback_ts(AC(),fn);
+}
+
+void kopt_set_combo_cache(long maxcombos)
+{
+	kopt_set_combo_cache_ts(maxcombos);
+}
+
+void kopt_get_combo_cache_stats(long *hits,long *reuses,long *misses,long *entries,long *combos)
+{
+	kopt_get_combo_cache_stats_ts(hits,reuses,misses,entries,combos);
+}
+
+void kopt_clear_combo_cache(void)
+{
+	kopt_clear_combo_cache_ts();
+}
+
 int kopt_lock_and_load(void)
 {
 	return kopt_lock_and_load_ts(AC());
@@ -58,6 +139,43 @@ int kopt_colllen(void)
 	return kopt_colllen_ts(AC());
 }
 
+void kopt_set_limits(double secs,long maxanal)
+{
+	kopt_set_limits_ts(AC(),secs,maxanal);
+}
+
+void kopt_cancel(void)
+{
+	kopt_cancel_ts(AC());
+}
+
+// Python can't run its own handler until we return, so we catch SIGINT ourselves.  A second one before the search notices kills us as usual.
+static void sigint_cancel(int sig)
+{
+	if (AC().IsCancelled())
+	{
+		signal(SIGINT,SIG_DFL);
+		raise(SIGINT);
+		return;
+	}
+	kopt_cancel_ts(AC());
+}
+
+void kopt_cancel_on_sigint(int on)
+{
+	signal(SIGINT,on?sigint_cancel:SIG_DFL);
+}
+
+int kopt_stop_reason(void)
+{
+	return kopt_stop_reason_ts(AC());
+}
+
+double kopt_coverage(void)
+{
+	return kopt_coverage_ts(AC());
+}
+
 int kopt_prepres(void)
 {
 	return kopt_prepres_ts(AC());
@@ -68,6 +186,26 @@ int kopt_getres(int n,unsigned int **r,float *m)
 	return kopt_getres_ts(AC(),n,r,m);
 }
 
+long kopt_getres_flat(long n,unsigned int *r,float *m,int sorted)
+{
+	return kopt_getres_flat_ts(AC(),n,r,m,sorted);
+}
+
+const void *kopt_resview(long *n,int *rsize,int *iw)
+{
+	return kopt_resview_ts(AC(),n,rsize,iw);
+}
+
+int kopt_bf_start(int debug)
+{
+	return kopt_bf_start_ts(AC(),debug);
+}
+
+int kopt_bf_next(int n,unsigned int **r,float *m)
+{
+	return kopt_bf_next_ts(AC(),n,r,m);
+}
+
 void kopt_release(void)
 {
 	kopt_release_ts(AC());
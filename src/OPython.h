@@ -9,18 +9,45 @@ See OAPI.h for API details.
 
 */
 
+#include "OSink.h"
+
 extern "C" void kopt_init_struct(int nf,int pf,int *pfn,int pfnn,int ni,float mc,int nc);
-extern "C" void kopt_init_parms(float ctol,float itol,int ntol,int resnumb,long maxres,int smode);
+extern "C" void kopt_init_parms(float ctol,float itol,int ntol,int resnumb,long maxres,int smode,int nthreads);
 extern "C" void kopt_init_feature(int fn,int ng,int ni,int ispart,int **f);
 extern "C" void kopt_init_items(float *c,float *v);
 extern "C" void kopt_set_constraint(int cn,int t,int al,int *a);
 extern "C" void kopt_set_maxcosttol(float x);
+extern "C" void kopt_set_bound_mode(int bmode,int nbins);
+extern "C" void kopt_set_combo_cull(float gtol,int gntol);
+extern "C" void kopt_set_combo_cap(long maxcombos);
+extern "C" int kopt_set_plan(int *order,int *bycost);
+extern "C" void kopt_set_autotune(long probenodes);
+extern "C" int kopt_get_plan(int *order,int *bycost);
+extern "C" void kopt_set_warmstart(int nseed);
+extern "C" void kopt_set_scalar(int scalar);
+extern "C" void kopt_set_spill(long rammb,const char *dir);
+extern "C" void kopt_set_packed(int packed);
+extern "C" int kopt_set_sink_file(const char *path,int text);
+extern "C" int kopt_set_sink_pipe(const char *cmd,int text);
+extern "C" void kopt_set_sink_callback(OCollSinkFn fn);
+extern "C" void kopt_set_combo_cache(long maxcombos);
+extern "C" void kopt_get_combo_cache_stats(long *hits,long *reuses,long *misses,long *entries,long *combos);
+extern "C" void kopt_clear_combo_cache(void);
 extern "C" int kopt_lock_and_load(void);
 extern "C" double kopt_get_log_state_space_est(void);
 extern "C" int kopt_execute(int debug);
+extern "C" void kopt_set_limits(double secs,long maxanal);
+extern "C" void kopt_cancel(void);
+extern "C" void kopt_cancel_on_sigint(int on);
+extern "C" int kopt_stop_reason(void);
+extern "C" double kopt_coverage(void);
 extern "C" int kopt_prepres(void);
 extern "C" int kopt_colllen(void);
 extern "C" int kopt_getres(int n,unsigned int **r,float *m);
+extern "C" long kopt_getres_flat(long n,unsigned int *r,float *m,int sorted);
+extern "C" const void *kopt_resview(long *n,int *rsize,int *iw);
+extern "C" int kopt_bf_start(int debug);
+extern "C" int kopt_bf_next(int n,unsigned int **r,float *m);
 extern "C" void kopt_release(void);
 extern "C" void kopt_reset(void);
 
@@ -1,11 +1,17 @@
-#include <list>
 #include <set>
 #include <vector>
+#include <queue>
 #include <assert.h>
 #include <string.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <time.h>
 #include "OConfig.h"
 #include "OSearch.h"
 #include "OColl.h"
+#include "OPool.h"
+#include "OCache.h"
 
 //// Useful calc fns
 
@@ -14,39 +20,44 @@
 long OSGrpCombos::nchoosem(int n,int m)
 {
 	if (n<=0||m<=0||m>n) return 0;
-	if (m==n) return 1;
 	long x= 1;
-	long y= 1;
-	for (int j=0;j<m;++j)
+	for (int j=1;j<=m;++j)
 	{
-		x*= (long)(n-j);
-		y*= (long)(j+1);
+		// x is (n-m+j-1) choose (j-1), so x*(n-m+j) is divisible by j
+		long f= n-m+j;
+		if (x>LONG_MAX/f) return LONG_MAX;
+		x= x*f/j;
 	}
-	assert ((x % y)==0);
-	return x/y;
+	return x;
 }
 
 OSGrpCombos::~OSGrpCombos(void) { Clear(); }
 
 void OSGrpCombos::Clear(void)
 {
-	if (_i) delete [] _i;
-	if (_v) delete [] _v;
-	if (_c) delete [] _c;
+	free(_i);
+	free(_v);
+	free(_c);
+	delete [] _rix;
 	_i= NULL;
 	_v= NULL;
 	_c= NULL;
+	_rix= NULL;
+	_rp2= 0;
 	_bycost= false;
 	_np= 0;
 	_nc= 0;
+	_nall= 0;
+	_capped= false;
 }
 
-bool OSGrpCombos::Build(bool bycost,int np,int ni,float *v,float *c,const int *n)
+bool OSGrpCombos::Build(bool bycost,int np,int ni,float *v,float *c,const int *n,float maxc,long cap,long &nbud)
 {
+	nbud= 0;
 	if (np<=0||ni<=0||!v||!c||!n) return false;
 	if (_i) return false; 	// Already built, must call Clear() first
 
-	if (!build(bycost,np,ni,v,c,n))
+	if (!build(bycost,np,ni,v,c,n,maxc,cap,nbud))
 	{
 		Clear();
 		return false;
@@ -54,104 +65,492 @@ bool OSGrpCombos::Build(bool bycost,int np,int ni,float *v,float *c,const int *n
 	return true;
 }
 
-void OSGrpCombos::initctr(int *c,int n)
+// Every combo, summed just as build() does, and sorted.  The sort is kept for next time, and those which fit then are picked out as for fromsorted().  build() generates a superset of those which fit (over budget, and not taken for lack of a cap), so we keep the same combos and nbud is the same.
+bool OSGrpCombos::fromtuples(const int16_t *t,const float *iv,const float *ic,float *v,float *c,float maxc,long &nbud)
 {
-	for (int i=0;i<n;++i) c[i]= i;
+	resize(_nall);
+	std::vector<int> raw(_np);
+	for (long k=0;k<_nall;++k)
+	{
+		for (int j=0;j<_np;++j) raw[j]= t[k*_np+j];
+		float rv= 0.0;
+		for (int j=0;j<_np;++j)
+		{
+			float vv= v[_n[raw[j]]];
+			if (IsBadVal(vv)) { rv= BadVal(); break; }
+			rv+= vv;
+		}
+		float rc= 0.0;
+		for (int j=0;j<_np;++j)
+		{
+			float cc= c[_n[raw[j]]];
+			if (IsBadCost(cc)) { rc= BadCost(); break; }
+			rc+= cc;
+		}
+		_v[k]= rv;
+		_c[k]= rc;
+		memcpy(_i+k*_np,&(raw[0]),_np*sizeof(int));
+	}
+	_nc= _nall;
+	if (!sortcombos()) return false;
+	OComboCache::Global().Store(_n,_ni,_np,iv,ic,_i,_v,_c);
+
+	// Keep those which fit, in order
+	long j= 0;
+	for (long k=0;k<_nc;++k)
+	{
+		if (_c[k]>maxc)
+		{
+			++nbud;
+			continue;
+		}
+		if (j<k)
+		{
+			memcpy(_i+j*_np,_i+k*_np,_np*sizeof(int));
+			_v[j]= _v[k];
+			_c[j]= _c[k];
+		}
+		++j;
+	}
+	_nc= j;
+	if (_nc<_nall) resize(_nc);
+	if (_nc<=0) return true;
+	buildindex();
+	return true;
 }
 
-bool OSGrpCombos::nextctr(int *cl,int *cn,int np,int ni)
+// The combos in their final order already, so we just take those which fit.  Filtering keeps the order, so it's what sorting only those which fit would give.
+bool OSGrpCombos::fromsorted(const int16_t *t,const float *sv,const float *sc,float maxc,long &nbud)
 {
-	memcpy(cn,cl,sizeof(int)*np);
-	for (int i=np-1;i>=0;--i)
+	for (long k=0;k<_nall;++k)
+		if (sc[k]>maxc) ++nbud;
+	if (_nall-nbud<=0) return true;
+	resize(_nall-nbud);
+	for (long k=0;k<_nall;++k)
 	{
-		if (cn[i]>=ni-np+i) continue;		// We're at max in this slot, so try augmenting next slot.
-		cn[i]++;
-		for (int j=i+1;j<np;++j)
-			cn[j]= cn[i]+j-i;
-		return true;
+		if (sc[k]>maxc) continue;
+		for (int j=0;j<_np;++j) _i[_nc*_np+j]= t[k*_np+j];
+		_v[_nc]= sv[k];
+		_c[_nc]= sc[k];
+		++_nc;
 	}
-	return false;
+	buildindex();
+	return true;
 }
 
-bool OSGrpCombos::OSGRecCmpValDesc(const OSGCRec &a,const OSGCRec &b) { return (a._v>b._v); }
+// Order-preserving map of a float to an unsigned int.  Both zeros map alike, since they compare equal.
+static inline uint32_t floatkey(float f)
+{
+	uint32_t u;
+	if (f==0) f= 0;
+	memcpy(&u,&f,sizeof(u));
+	return (u&0x80000000u)?~u:(u|0x80000000u);
+}
 
-bool OSGrpCombos::OSGRecCmpCostAsc(const OSGCRec &a,const OSGCRec &b) { return (a._c<b._c); }
+// Ties on the key are ordered by their items.  _i of each combo is sorted.
+struct OSGCItemLess
+{
+	const int *_i;
+	int _np;
+	OSGCItemLess(const int *i,int np) : _i(i), _np(np) {}
+	bool operator()(uint32_t a,uint32_t b) const { return std::lexicographical_compare(_i+(long)a*_np,_i+(long)(a+1)*_np,_i+(long)b*_np,_i+(long)(b+1)*_np); }
+};
 
+void OSGrpCombos::resize(long n)
+{
+	int *i= AlignedNew<int>(n*_np);
+	float *v= AlignedNew<float>(n);
+	float *c= AlignedNew<float>(n);
+	if (_nc>0)
+	{
+		memcpy(i,_i,_nc*_np*sizeof(int));
+		memcpy(v,_v,_nc*sizeof(float));
+		memcpy(c,_c,_nc*sizeof(float));
+	}
+	free(_i);
+	free(_v);
+	free(_c);
+	_i= i;
+	_v= v;
+	_c= c;
+}
 
-bool OSGrpCombos::build(bool bycost,int np,int ni,float *v,float *c,const int *n)
+// Final order of the combos: by value or cost, then by their items.  That's the order we always have used (a stable sort of the combos in lexicographic order), so the search visits exactly what it used to.
+// The generator emits them almost in order already (it differs only where the double and float sums disagree), so we first check whether they're sorted on the key.  Otherwise an LSD radix sort on the key, 11 bits a pass, skipping passes on which every key agrees.  Then ties are put in item order, and the permutation is applied in place by following its cycles.
+bool OSGrpCombos::sortcombos(void)
+{
+	if (_nc<=1) return true;
+	if (_nc>(long)UINT32_MAX) return false;
+	uint32_t n= _nc;
+	std::vector<uint32_t> k(n),p(n);
+	for (uint32_t j=0;j<n;++j)
+	{
+		k[j]= _bycost?floatkey(_c[j]):~floatkey(_v[j]);
+		p[j]= j;
+	}
+	bool sorted= true;
+	for (uint32_t j=1;j<n&&sorted;++j) sorted= (k[j-1]<=k[j]);
+	if (!sorted)
+	{
+		const int nb= 11;
+		const uint32_t nbk= 1u<<nb;
+		std::vector<uint32_t> k2(n),p2(n);
+		std::vector<uint32_t> cnt(nbk);
+		for (int sh=0;sh<32;sh+=nb)
+		{
+			std::fill(cnt.begin(),cnt.end(),0);
+			for (uint32_t j=0;j<n;++j) ++cnt[(k[j]>>sh)&(nbk-1)];
+			if (cnt[(k[0]>>sh)&(nbk-1)]==n) continue;	// Every key has the same digit
+			uint32_t o= 0;
+			for (uint32_t d=0;d<nbk;++d)
+			{
+				uint32_t x= cnt[d];
+				cnt[d]= o;
+				o+= x;
+			}
+			for (uint32_t j=0;j<n;++j)
+			{
+				uint32_t d= cnt[(k[j]>>sh)&(nbk-1)]++;
+				k2[d]= k[j];
+				p2[d]= p[j];
+			}
+			k.swap(k2);
+			p.swap(p2);
+		}
+	}
+
+	// Ties, by items
+	OSGCItemLess il(_i,_np);
+	for (uint32_t j=0;j<n;)
+	{
+		uint32_t e= j+1;
+		while (e<n&&k[e]==k[j]) ++e;
+		if (e-j>1) std::sort(p.begin()+j,p.begin()+e,il);
+		j= e;
+	}
+
+	// Apply.  p[j] is where the combo which belongs at j is now.
+	std::vector<int> ti(_np);
+	for (uint32_t j=0;j<n;++j)
+	{
+		if (p[j]==j) continue;
+		float tv= _v[j], tc= _c[j];
+		memcpy(&(ti[0]),_i+(long)j*_np,_np*sizeof(int));
+		uint32_t d= j;
+		while (true)
+		{
+			uint32_t s= p[d];
+			p[d]= d;
+			if (s==j)
+			{
+				_v[d]= tv;
+				_c[d]= tc;
+				memcpy(_i+(long)d*_np,&(ti[0]),_np*sizeof(int));
+				break;
+			}
+			_v[d]= _v[s];
+			_c[d]= _c[s];
+			memcpy(_i+(long)d*_np,_i+(long)s*_np,_np*sizeof(int));
+			d= s;
+		}
+	}
+	return true;
+}
+
+// Materializing every combo and sorting them is hopeless for a big group (e.g. a flex slot open to the whole slate), so we generate them best first instead and stop once we have all we'll keep.  Sorted by cost, that's as soon as they stop fitting the budget.  Sorted by value, the budget doesn't end the run, but those which don't fit still are never stored.
+// Sort the items best first.  A combo is a set of np positions in that list.  The best combo is the first np positions, and every other is reached from it along exactly one path: move the last position right one step at a time until it's where we want it, then likewise the one before it, and so on.  So a state is a combo together with the position being moved, and it has at most two successors: move that position one more step, or begin moving the one before it (if it can move at all).  Neither successor is better than the state, so a heap holding the successors of every state taken so far always has the best combo not yet taken at the top.  We hold at most one more state than we've taken, and reuse their slots.
+// The heap sums keys in double, in whatever order the path took.  The combos we keep are summed in float over their items in item order, just as they always have been, and the final sort is on those sums.  We end the run a hair beyond the budget in case the two sums disagree there.
+bool OSGrpCombos::build(bool bycost,int np,int ni,float *v,float *c,const int *n,float maxc,long cap,long &nbud)
 {
 	_bycost= bycost;
 	_np= np;
 	if (ni<np) return false;
-	_nc= nchoosem(ni,np);		// Total combos for this group
-	if (_nc<=0) return false;
+	_nall= nchoosem(ni,np);		// Total combos for this group
+	if (_nall<=0) return false;
 	_n= n;
 	_ni= ni;
 
-	// Create arrays
-	long sz= (_nc+1)*(long)_np;	// The 1 in _nc+1 is a special safety buffer because of the way we generate things
-	_i= new int[sz];
-	_v= new float[_nc];
-	_c= new float[_nc];
+	// Items, best first
+	std::vector<std::pair<double,int> > it(ni);
+	for (int k=0;k<ni;++k)
+	{
+		float x= bycost?c[_n[k]]:v[_n[k]];
+		it[k]= std::pair<double,int>((bycost?IsBadCost(x):IsBadVal(x))?-1e30:(bycost?-(double)x:(double)x),-k);
+	}
+	std::sort(it.rbegin(),it.rend());	// Descending key, then ascending item
+	std::vector<double> sk(ni);
+	std::vector<int> ord(ni);
+	for (int k=0;k<ni;++k)
+	{
+		sk[k]= it[k].first;
+		ord[k]= -it[k].second;
+	}
+	double klim= -(maxc+1e-4*(1+fabs(maxc)));	// Sorted by cost, no combo with a key below this fits
 
-	// Populate _i
-	initctr(_i,_np);
-	long i=-1;
-	do
+	// Sorted by value, we'd generate every combo anyway, so a group small enough to cache (see OComboCache) has them listed instead.  Not if the cap could bite, since it keeps the first cap in the order we generate them, which needn't be the final order when some tie.
+	if (!bycost&&(cap<=0||cap>=_nall))
 	{
-		i= i+1;
-	} while(nextctr(&(_i[_np*i]),&(_i[_np*(i+1)]),_np,ni));
+		std::vector<float> iv(ni),ic(ni),sv,sc;
+		for (int k=0;k<ni;++k)
+		{
+			iv[k]= v[_n[k]];
+			ic[k]= c[_n[k]];
+		}
+		std::vector<int16_t> t;
+		int rc= OComboCache::Global().Lookup(_n,ni,np,_nall,&(iv[0]),&(ic[0]),t,sv,sc);
+		if (rc==2) return fromsorted(&(t[0]),&(sv[0]),&(sc[0]),maxc,nbud);
+		if (rc==1) return fromtuples(&(t[0]),&(iv[0]),&(ic[0]),v,c,maxc,nbud);
+	}
 
-	if (i!=_nc-1) return false;	// If =_nc+1 then too many combos, if less than _nc then too few.  Testing this is why we have the extra _nc+1 slot!
+	std::vector<int> pool;		// Positions of each state
+	std::vector<long> pfree;	// Free slots in the pool
+	std::priority_queue<OSGCState> h;
+	OSGCState s;
+	s._k= 0;
+	for (int j=0;j<np;++j)
+	{
+		pool.push_back(j);
+		s._k+= sk[j];
+	}
+	s._p= 0;
+	s._m= np-1;
+	h.push(s);
 
-	// Populate our temp list
-	typedef std::list<OSGCRec> RLIST;
-	RLIST r;
-	for (long i=0;i<_nc;++i)
+	std::vector<int> raw(np);
+	long room= 0;		// Combos _i, _v, _c have room for
+	long ngen= 0;
+	while (!h.empty())
 	{
+		s= h.top();
+		if (bycost&&s._k<klim) break;
+		if (cap>0&&_nc>=cap)
+		{
+			_capped= true;
+			break;
+		}
+		h.pop();
+		++ngen;
+
+		// Keep it?
+		const int *p= &(pool[s._p]);
+		for (int j=0;j<np;++j) raw[j]= ord[p[j]];
+		std::sort(raw.begin(),raw.end());
 		float rv= 0.0;
 		for (int j=0;j<_np;++j)
 		{
-			float vv= v[_n[_i[_np*i+j]]];
+			float vv= v[_n[raw[j]]];
 			if (IsBadVal(vv)) { rv= BadVal(); break; }
 			rv+= vv;
 		}
 		float rc= 0.0;
 		for (int j=0;j<_np;++j)
 		{
-			float cc= c[_n[_i[_np*i+j]]];
+			float cc= c[_n[raw[j]]];
 			if (IsBadCost(cc)) { rc= BadCost(); break; }
 			rc+= cc;
 		}
-		r.push_back(OSGCRec(i,rv,rc));
+		if (rc>maxc) ++nbud;
+		else
+		{
+			if (_nc==room)
+			{
+				room= std::max(2*room,1024L);
+				if (room>_nall) room= _nall;
+				if (cap>0&&room>cap) room= cap;
+				resize(room);
+			}
+			_v[_nc]= rv;
+			_c[_nc]= rc;
+			memcpy(_i+_nc*_np,&(raw[0]),_np*sizeof(int));
+			++_nc;
+		}
+
+		// Its successors
+		for (int d=0;d<2;++d)
+		{
+			int m= s._m-d;
+			if (m<0) break;
+			int e= (m==np-1)?ni:pool[s._p+m+1];
+			if (pool[s._p+m]+1>=e) continue;
+			OSGCState x;
+			if (pfree.empty())
+			{
+				x._p= pool.size();
+				pool.resize(pool.size()+np);
+			}
+			else
+			{
+				x._p= pfree.back();
+				pfree.pop_back();
+			}
+			std::copy(pool.begin()+s._p,pool.begin()+s._p+np,pool.begin()+x._p);
+			int q= pool[x._p+m]++;
+			x._k= s._k-sk[q]+sk[q+1];
+			x._m= m;
+			h.push(x);
+		}
+		pfree.push_back(s._p);
 	}
-	
-	// Sort our temp list
-	if (bycost) r.sort(OSGRecCmpCostAsc);
-	else r.sort(OSGRecCmpValDesc);
+	if (bycost&&!_capped) nbud+= _nall-ngen;	// The rest cost even more
+	if (_nc<=0) return true;
+	if (room>_nc) resize(_nc);
+	if (!sortcombos()) return false;
+	buildindex();
+	return true;
+}
 
-	// Repopulate arrays
-	i=0;
-	int *itmp= new int [sz];
-	for (RLIST::const_iterator ii= r.begin();ii!=r.end();++ii)
+// A Fenwick tree over the positions of the combos in cost order.  We visit the combos in decreasing order of value, first adding every combo worth more than v*(1+gtol) and then counting how many of those cost no more.  The (v,c) pairs are in the same order as v*(1+gtol) provided gtol>=0.
+bool OSGrpCombos::Cull(float gtol,int gntol,long &ndom)
+{
+	ndom= 0;
+	if (_nc<=0) return true;
+	std::vector<char> keep(_nc,1);
+	long n= _nc;
+	if (gtol>=0&&n>1)
 	{
-		_v[i]= ii->_v;
-		_c[i]= ii->_c;
-		long n1= ii->_n;
-		memcpy(&(itmp[i*_np]),&(_i[n1*_np]),_np*sizeof(int));
-		++i;
+		std::vector<std::pair<float,long> > byc(n);
+		std::vector<std::pair<float,long> > byv(n);
+		for (long k=0;k<n;++k)
+		{
+			byc[k]= std::pair<float,long>(_c[k],k);
+			byv[k]= std::pair<float,long>(-_v[k],k);
+		}
+		std::sort(byc.begin(),byc.end());
+		std::sort(byv.begin(),byv.end());	// Now by value in desc order
+		std::vector<long> pos(n);		// Position of each in cost order
+		std::vector<long> le(n);		// Number of combos costing no more than each
+		for (long k=0;k<n;++k) pos[byc[k].second]= k;
+		for (long k=n-1;k>=0;--k) le[byc[k].second]= (k<n-1&&byc[k+1].first==byc[k].first)?le[byc[k+1].second]:(k+1);
+		std::vector<long> ft(n+1,0);
+		long a= 0;
+		for (long q=0;q<n;++q)
+		{
+			long kq= byv[q].second;
+			float tv= _v[kq]*(1.0+gtol);
+			for (;a<n&&_v[byv[a].second]>tv;++a)
+				for (long x=pos[byv[a].second]+1;x<=n;x+= x&(-x)) ft[x]++;
+			long cnt= 0;
+			for (long x=le[kq];x>0;x-= x&(-x)) cnt+= ft[x];
+			if (_v[kq]>tv) --cnt;	// Don't count ourselves
+			if (cnt>=1+gntol)
+			{
+				keep[kq]= 0;
+				++ndom;
+			}
+		}
 	}
-	delete [] _i;
-	_i= itmp;
+	if (ndom==0) return true;
 
+	// Squeeze out the culled combos
+	long j= 0;
+	for (long i=0;i<_nc;++i)
+	{
+		if (!keep[i]) continue;
+		if (i!=j)
+		{
+			memmove(&(_i[j*_np]),&(_i[i*_np]),_np*sizeof(int));
+			_v[j]= _v[i];
+			_c[j]= _c[i];
+		}
+		++j;
+	}
+	_nc= j;
+	delete [] _rix;
+	_rix= NULL;
+	buildindex();
 	return true;
 }
 
+// Padding leaves never pass either test
+void OSGrpCombos::buildindex(void)
+{
+	_rp2= 1;
+	while (_rp2<_nc) _rp2*= 2;
+	_rix= new float [2*_rp2];
+	for (long j=0;j<_rp2;++j)
+	{
+		if (_bycost) _rix[_rp2+j]= (j<_nc)?_v[j]:-FLT_MAX;
+		else _rix[_rp2+j]= (j<_nc)?_c[j]:FLT_MAX;
+	}
+	for (long k=_rp2-1;k>0;--k)
+	{
+		if (_bycost) _rix[k]= std::max(_rix[2*k],_rix[2*k+1]);
+		else _rix[k]= std::min(_rix[2*k],_rix[2*k+1]);
+	}
+}
+
+// Both tests are monotone in the indexed quantity, so a range contains a passing combo iff its min cost (or max value) passes.  From leaf i we climb until we can step right into a subtree which contains one, then descend to its leftmost.
+long OSGrpCombos::NextCheapEnough(long i,float mrc,float lim) const
+{
+	long e= std::min(i+_kn->_scan,_nc);
+	i= _kn->_cheap(_c,i,e,mrc,lim);		// Most runs are short, so try a block scan first
+	if (i<e||i>=_nc) return i;
+	long k= _rp2+i;
+	while (_rix[k]+mrc>lim)
+	{
+		while (k&1) k>>= 1;
+		if (k==0) return _nc;
+		++k;
+	}
+	while (k<_rp2)
+	{
+		k*= 2;
+		if (_rix[k]+mrc>lim) ++k;
+	}
+	return (k-_rp2<_nc)?(k-_rp2):_nc;
+}
+
+long OSGrpCombos::NextGoodEnough(long i,float mrv,float val,float mv) const
+{
+	long e= std::min(i+_kn->_scan,_nc);
+	i= _kn->_good(_v,i,e,mrv,val,mv);
+	if (i<e||i>=_nc) return i;
+	long k= _rp2+i;
+	while (_rix[k]+mrv+val<mv)
+	{
+		while (k&1) k>>= 1;
+		if (k==0) return _nc;
+		++k;
+	}
+	while (k<_rp2)
+	{
+		k*= 2;
+		if (_rix[k]+mrv+val<mv) ++k;
+	}
+	return (k-_rp2<_nc)?(k-_rp2):_nc;
+}
+
+long OSGrpCombos::FirstTooCostly(long i,float mrc,float lim) const
+{
+	long lo= i;
+	long hi= _nc;
+	while (lo<hi)
+	{
+		long m= (lo+hi)/2;
+		if (_c[m]+mrc>lim) hi= m;
+		else lo= m+1;
+	}
+	return lo;
+}
+
+long OSGrpCombos::FirstTooPoor(long i,float mrv,float val,float mv) const
+{
+	long lo= i;
+	long hi= _nc;
+	while (lo<hi)
+	{
+		long m= (lo+hi)/2;
+		if (_v[m]+mrv+val<mv) hi= m;
+		else lo= m+1;
+	}
+	return lo;
+}
+
 //////// OSGrpRec
 
-OSGrpRec::OSGrpRec(void) : _g(-1), _np(0), _bval(BadVal()), _lcost(BadCost()), _rbval(BadVal()), _rlcost(BadCost()), _rcombos(0), _ni(0), _i(NULL), _gc() {}
+OSGrpRec::OSGrpRec(void) : _g(-1), _np(0), _bval(BadVal()), _lcost(BadCost()), _rbval(BadVal()), _rlcost(BadCost()), _rcombos(0), _rleaves(0), _ni(0), _i(NULL), _gc(), _chkdup(false), _nmw(0), _mwi(NULL), _cmask(NULL), _nsym(0), _symlev(NULL), _symmy(NULL), _symot(NULL), _symoff(NULL) {}
 
-bool OSGrpRec::Init(const OConfig &x,int g,bool bycost)
+bool OSGrpRec::Init(const OConfig &x,int g)
 {
 	if (_g>=0) return false;	// Already set
 	if (g<0||g>=x.NumPrimaryGroups()) return false;
@@ -184,12 +583,71 @@ bool OSGrpRec::Init(const OConfig &x,int g,bool bycost)
 		_bval+= fl[_ni-i-1];
 	}
 
-	// Combo generations and sorting
-	if (!_gc.Build(bycost,_np,_ni,x.Vals(),x.Costs(),_i)) return false;
+	return true;
+}
 
+bool OSGrpRec::Build(const OConfig &x,bool bycost,float orc,long &ndom,long &nbud)
+{
+	ndom= 0;
+	if (!_gc.Build(bycost,_np,_ni,x.Vals(),x.Costs(),_i,x.MaxCost()+x.MaxCostTol()-orc,x.MaxCombos(),nbud)) return false;
+	if (!_gc.Cull(x.ComboTol(),x.ComboNTol(),ndom)) return false;
+	if ((ndom+nbud==0&&!_gc.Capped())||Combos()==0) return true;
+	_bval= _gc.Val(0);
+	_lcost= _gc.Cost(0);
+	for (long i=1;i<Combos();++i)
+	{
+		_bval= std::max(_bval,_gc.Val(i));
+		_lcost= std::min(_lcost,_gc.Cost(i));
+	}
 	return true;
 }
 
+void OSGrpRec::BuildMasks(int nmw,const int *mwi,const uint64_t *ov)
+{
+	ClearMasks();
+	long nc= Combos();
+	if (nmw<=0||nc<=0) return;
+	_nmw= nmw;
+	_mwi= new int [nmw];
+	memcpy(_mwi,mwi,sizeof(int)*nmw);
+	_cmask= new uint64_t [nc*nmw];
+	memset(_cmask,0,sizeof(uint64_t)*nc*nmw);
+	for (long i=0;i<nc;++i)
+	{
+		uint64_t *m= _cmask+i*nmw;
+		for (int j=0;j<_np;++j)
+		{
+			int it= Item(i,j);
+			uint64_t b= 1ULL<<(it&63);
+			if (!(ov[it>>6]&b)) continue;	// Can't collide, so leave it out
+			for (int k=0;k<nmw;++k)
+				if (mwi[k]==(it>>6)) m[k]|= b;
+		}
+	}
+}
+
+void OSGrpRec::ClearMasks(void)
+{
+	delete [] _mwi;
+	delete [] _cmask;
+	_mwi= NULL;
+	_cmask= NULL;
+	_nmw= 0;
+}
+
+void OSGrpRec::ClearSym(void)
+{
+	delete [] _symlev;
+	delete [] _symmy;
+	delete [] _symot;
+	delete [] _symoff;
+	_symlev= NULL;
+	_symmy= NULL;
+	_symot= NULL;
+	_symoff= NULL;
+	_nsym= 0;
+}
+
 void OSGrpRec::DumpCombos(FILE *f) const
 {
 	if (!f) return;
@@ -213,19 +671,139 @@ void OSGrpRec::DumpCombos(FILE *f) const
 }
 
 
+//////// OSState
+
+void OSState::Init(int ng,int cs,int nwd,int ncnt)
+{
+	clear();
+	_stk= new OSFrame [ng];
+	for (int i=0;i<ng;++i)
+	{
+		_stk[i]._i= -1;
+		_stk[i]._rcost= 0;
+		_stk[i]._val= 0;
+	}
+	_sp= -1;
+	_base= 0;
+	_tcol= new int [cs];
+	_ci= new long [ng];
+	_used= new uint64_t [(long)ng*nwd];
+	memset(_used,0,sizeof(uint64_t)*ng*nwd);
+	_pcnt= new long [ncnt];
+	memset(_pcnt,0,sizeof(long)*ncnt);
+	_cov= 0;
+	_nnn= 0;
+	_apub= 0;
+	_res= NULL;
+	_rseq= 0;
+	_rlast= 0;
+}
+
+void OSState::clear(void)
+{
+	delete [] _stk;
+	delete [] _tcol;
+	delete [] _ci;
+	delete [] _used;
+	delete [] _pcnt;
+	delete _res;
+	_stk= NULL;
+	_tcol= NULL;
+	_ci= NULL;
+	_used= NULL;
+	_pcnt= NULL;
+	_res= NULL;
+}
+
+//////// OSearchJob
+
+// Runs the tasks of a parallel search on the pool
+class OSearchJob : public OPoolJob
+{
+protected:
+	OSearch *_s;
+public:
+	OSearchJob(OSearch *s) : _s(s) {}
+	virtual void Run(int w,long t) { _s->runtask(_s->_st[w],t); }
+};
+
+//////// OSBuildJob
+
+// Builds the combos of each group on the pool, one task per group
+class OSBuildJob : public OPoolJob
+{
+protected:
+	OSGrpRec *_r;
+	const OConfig &_x;
+	const bool *_bycost;
+	double _tlc;		// Sum of the cheapest picks of every group
+	char *_ok;		// Per group: built?
+	long *_ndom;		// Per group: culled as dominated
+	long *_nbud;		// Per group: over budget
+public:
+	OSBuildJob(OSGrpRec *r,const OConfig &x,const bool *bycost,double tlc,char *ok,long *ndom,long *nbud) : _r(r), _x(x), _bycost(bycost), _tlc(tlc), _ok(ok), _ndom(ndom), _nbud(nbud) {}
+	virtual void Run(int w,long t) { _ok[t]= _r[t].Build(_x,_bycost[t],_tlc-_r[t]._lcost,_ndom[t],_nbud[t]); }
+};
+
 //////// OSearch
 
-OSearch::OSearch(void) : OMtxCtlBase(), _r(NULL), _rp(NULL), _oc(NULL), _m(NULL), _ng(0), _nc(0), _bycost(false), _cs(0), _pcnt(NULL), _icnt(NULL), _tcol(NULL), _tloc(NULL) {}
+OSearch::OSearch(void) : OMtxCtlBase(), _r(NULL), _rp(NULL), _oc(NULL), _m(NULL), _ng(0), _nc(0), _cs(0), _debug(0), _nwd(0), _lastdup(-1), _nw(1), _npre(0), _ntask(0), _pdone(false), _seqbase(0), _seqstep(0), _st(NULL), _thr(BadVal()), _thrc(BadVal()), _bmode(0), _nb(0), _bq(0), _sbt(NULL), _tend(0), _maxanal(0), _cancel(NULL), _nanal(0), _stop(false), _why(0), _nseed(0), _wsval(BadVal()), _wsthr(BadVal()), _lv(NULL), _pcnt(NULL), _tloc(NULL) {}
 OSearch::~OSearch(void) 
 { 
 	delete [] _r; 
 	delete [] _rp;
+	delete [] _st;
+	delete [] _sbt;
 	delete [] _pcnt;
-	delete [] _tcol;
 	delete [] _tloc;
+	delete [] _lv;
+}
+
+static double monotime(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec+1e-9*t.tv_nsec;
+}
+
+void OSearch::publish(float v,float c)
+{
+	float x= _thr.load(std::memory_order_relaxed);
+	while ((IsBadVal(x)||v>x)&&!_thr.compare_exchange_weak(x,v,std::memory_order_relaxed)) {}
+	x= _thrc.load(std::memory_order_relaxed);
+	while ((IsBadVal(x)||c>x)&&!_thrc.compare_exchange_weak(x,c,std::memory_order_relaxed)) {}
 }
 
 bool OSearch::Search(const OConfig &x,bool bycost,bool grouplowtohigh,int debug)
+{
+	if (!Prepare(x,bycost,grouplowtohigh,debug)) return false;
+	WarmStart(x.WarmStarts());
+	return (Continue(0)>0);
+}
+
+bool OSearch::Prepare(const OConfig &x,bool bycost,bool grouplowtohigh,int debug)
+{
+	int ng= x.NumPrimaryGroups();
+	if (ng<=0) return false;
+	bool *bc= new bool [ng];
+	for (int g=0;g<ng;++g) bc[g]= bycost;
+	bool rc= prepare(x,NULL,bc,grouplowtohigh,x.NumThreads(),x.AccessMM(),x.TimeLimit(),debug);
+	delete [] bc;
+	return rc;
+}
+
+bool OSearch::Prepare(const OConfig &x,const int *order,const bool *bycost,int debug)
+{
+	int ng= x.NumPrimaryGroups();
+	if (ng<=0) return false;
+	bool *bc= new bool [ng];
+	for (int g=0;g<ng;++g) bc[g]= bycost?bycost[g]:x.IsSearchByCost();
+	bool rc= prepare(x,order,bc,x.IsGroupLowToHigh(),x.NumThreads(),x.AccessMM(),x.TimeLimit(),debug);
+	delete [] bc;
+	return rc;
+}
+
+bool OSearch::prepare(const OConfig &x,const int *order,const bool *bycost,bool grouplowtohigh,int nw,OCollMM *m,double tlim,int debug)
 {
 	OSrchMtxCtl mtx(this);
 	int ng= x.NumPrimaryGroups();
@@ -233,29 +811,76 @@ bool OSearch::Search(const OConfig &x,bool bycost,bool grouplowtohigh,int debug)
 	_nc= x.NumConstraints();
 	if (_nc<0) return false;
 	if (_r) return false;	// Already set
-	_bycost= bycost;
+	if (!m) return false;
 	_cs= x.CollectionSize();
+	_debug= debug;
 
 	// Create ordered list of groups decreasing by number of picks, then number of items
 	_r= new OSGrpRec [ng];
 	_rp= new OSGrpRec* [ng];
 	_ng= ng;
 	_oc= &x;
-	_m= _oc->AccessMM();
+	_m= m;
 	if (_tloc) delete [] _tloc;
 	_tloc= new int [ng];
 
 	// Populate group info
+	const OKernel *kn= OKernel::Pick(x.ScalarKernel());
 	for (int i=0;i<ng;++i)		
-		if (!_r[i].Init(x,i,bycost)) return false;
+	{
+		if (!_r[i].Init(x,i)) return false;
+		_r[i]._gc.SetKernel(kn);
+	}
+	if (debug & 2) printf("Scan kernel: %s\n",kn->_name);
+
+	// Build and cull the combos.  Those which can't fit with the cheapest picks of every other group never are kept, the dominated ones are culled only if asked.
+	// The groups are independent, so are built concurrently.
+	double tlc= 0;
+	for (int i=0;i<ng;++i) tlc+= _r[i]._lcost;
+	double t0= monotime();
+	std::vector<long> ndom(ng,0),nbud(ng,0);
+	std::vector<char> ok(ng,0);
+	OSBuildJob bj(_r,x,bycost,tlc,&(ok[0]),&(ndom[0]),&(nbud[0]));
+	int nbw= std::min(std::max(nw,1),ng);
+	if (nbw==1) for (int i=0;i<ng;++i) bj.Run(0,i);
+	else
+	{
+		OWorkPool pool(nbw);
+		pool.Run(bj,ng);
+	}
+	for (int i=0;i<ng;++i)
+	{
+		if (!ok[i]) return false;
+		if (debug & 2) printf("Combo cull: group %d kept %ld of %ld combos (%ld over budget, %ld dominated%s)\n",i,_r[i].Combos(),_r[i]._gc.AllCombos(),nbud[i],ndom[i],_r[i]._gc.Capped()?", the rest capped":"");
+	}
+	if (debug & 2)
+	{
+		long nh,nr,nm,ne,ncc;
+		OComboCache::Global().Stats(&nh,&nr,&nm,&ne,&ncc);
+		printf("Combo build: %d groups on %d workers in %.3fs\n",ng,nbw,monotime()-t0);
+		printf("Combo cache: %ld hits (%ld more reusing the order), %ld misses so far, %ld entries holding %ld combos\n",nh,nr,nm,ne,ncc);
+	}
 
-	// Create sorted list of groups by combos
-	typedef std::vector<std::pair<long,OSGrpRec *> > AVEC;
-	AVEC av;
-	for (int i=0;i<ng;++i) av.push_back(std::pair<long,OSGrpRec *>(_r[i].Combos(),&(_r[i])));
-	std::sort(av.begin(),av.end());	// Sort on pairs sorts by 1st element first, so perfect.
-	if (!grouplowtohigh) std::reverse(av.begin(),av.end());
-	for (int i=0;i<ng;++i) _rp[i]= av[i].second;
+	// Create sorted list of groups by combos, unless we've been told the order
+	if (order)
+	{
+		std::vector<bool> seen(ng,false);
+		for (int i=0;i<ng;++i)
+		{
+			if (order[i]<0||order[i]>=ng||seen[order[i]]) return false;
+			seen[order[i]]= true;
+			_rp[i]= &(_r[order[i]]);
+		}
+	}
+	else
+	{
+		typedef std::vector<std::pair<long,OSGrpRec *> > AVEC;
+		AVEC av;
+		for (int i=0;i<ng;++i) av.push_back(std::pair<long,OSGrpRec *>(_r[i].Combos(),&(_r[i])));
+		std::sort(av.begin(),av.end());	// Sort on pairs sorts by 1st element first, so perfect.
+		if (!grouplowtohigh) std::reverse(av.begin(),av.end());
+		for (int i=0;i<ng;++i) _rp[i]= av[i].second;
+	}
 
 	if (debug & 8)
 		for (int i=0;i<ng;++i) 
@@ -263,20 +888,27 @@ bool OSearch::Search(const OConfig &x,bool bycost,bool grouplowtohigh,int debug)
 
 	// Accumulate sum info for group records
 	long cc= 1;
+	double cl= 1;
 	float rv= 0;
 	int rc= 0;
 	for (int i=ng-1;i>0;--i)
 	{
 		rv+= _rp[i]->_bval;
 		rc+= _rp[i]->_lcost;
-		cc*= _rp[i]->_gc.Combos();
+		long nc= _rp[i]->_gc.Combos();
+		cc= (nc>0&&cc>LONG_MAX/nc)?LONG_MAX:cc*nc;
+		cl*= nc;
 		_rp[i-1]->_rbval= rv;
 		_rp[i-1]->_rlcost= rc;
 		_rp[i-1]->_rcombos= cc;
+		_rp[i-1]->_rleaves= cl;
 	}
 	_rp[ng-1]->_rbval= 0;
 	_rp[ng-1]->_rlcost= 0;
 	_rp[ng-1]->_rcombos= 1;
+	_rp[ng-1]->_rleaves= 1;
+	_bmode= x.BoundMode();
+	setupbounds();
 
 	int tl= 0;
 	for (int i=0;i<ng;++i)
@@ -285,28 +917,622 @@ bool OSearch::Search(const OConfig &x,bool bycost,bool grouplowtohigh,int debug)
 		tl+= _rp[i]->_np;
 	}
 
-	// Init diagnostic counters
+	// Decide how to split the work.  We want enough tasks per worker for stealing to even out the load, but use as few prefix levels as possible. 
+	_nw= nw;
+	if (_nw<1) _nw= 1;
+	_npre= 0;
+	_ntask= 0;
+	if (_nw>1&&ng>1)
+	{
+		long nt= 1;
+		while (_npre<ng-1&&nt<64*(long)_nw)
+		{
+			nt*= _rp[_npre]->Combos();
+			++_npre;
+		}
+		_ntask= nt;
+	}
+	if (_ntask<=1)
+	{
+		_nw= 1;
+		_npre= 0;
+		_ntask= 0;
+	}
+
+	// Init per-worker state and diagnostic counters
+	if (_st) delete [] _st;
+	_st= new OSState [_nw];
+	setupdups();
+	setupsym();
+	setupplan();
+	_m->SetDedup(_lastdup>=0);	// Symmetry breaking should leave nothing for this to catch (unless the combo cull or cap turned it off), but it's cheap insurance
+	if (_m->GetNumReqs()==0)
+	{
+		// Pack the results as the combo chosen at each level, if asked
+		OCollCodec *cd= NULL;
+		if (x.PackedResults())
+		{
+			cd= new OCollCodec;
+			for (int g=0;g<ng;++g) cd->AddLevel(_lv[g]._nc,_lv[g]._np,_lv[g]._tloc,_lv[g]._it,_lv[g]._iw);
+			if (_debug & 2) printf("Packed results: %d bytes of combos per collection rather than %d of items\n",cd->NumBytes(),_cs*_m->ItemWidth());
+		}
+		_m->SetCodec(cd,true);
+	}
+	else if (_m->IsPacked())
+	{
+		printf("ERROR: OSearch can't add to results packed for the combos of an earlier search\n");
+		return false;
+	}
+	for (int w=0;w<_nw;++w) _st[w].Init(ng,_cs,_nwd,NumCounters());
+	for (int w=0;w<_nw&&_nw>1;++w)
+	{
+		_st[w]._res= new OCollMM(_cs,x.ResNumb(),x.MaxRes(),x.CTol(),_m->ItemWidth());
+		_st[w]._res->SetLocal(true);
+		_st[w]._res->SetCodec(_m->Codec(),false);
+		_st[w]._res->SetSink(_m->Sink());	// Each thread tells the sink of its own results.  Merging them only retracts.
+		_st[w]._res->SetSpill(x.SpillRAM()/_nw,x.SpillDir());
+		_st[w]._res->SetDedup(_lastdup>=0);
+	}
 	if (_pcnt) delete [] _pcnt;
 	_pcnt= new long [NumCounters()];
 	memset(_pcnt,0,sizeof(long)*NumCounters());
+	_thr.store(_m->GetBar());
+	_thrc.store(_m->GetMinAllowed());
+
+	// Early stopping
+	_tend= (tlim>0)?(monotime()+tlim):0;
+	_maxanal= x.MaxAnalyzed();
+	_cancel= x.CancelToken();
+	_nanal.store(0);
+	_stop.store(false);
+	_why.store(StopNone());
+
+	// Ready to go.  The parallel search primes each worker per task instead.
+	_pdone= false;
+	if (_nw==1) start(_st[0],0,_oc->MaxCost(),0.0);
+	return true;
+}
+
+void OSearch::GetPlan(int *order,bool *bycost) const
+{
+	for (int i=0;i<_ng;++i)
+	{
+		if (order) order[i]= _rp[i]->_g;
+		if (bycost) bycost[i]= _r[i]._gc.ByCost();
+	}
+}
 
-	// Init dup tester
-	if (_icnt) delete [] _icnt;
-	_icnt= new int [_oc->NumItems()];
+// The most valuable combo which fits.  Sorted by value, that's the first which fits and doesn't clash (the range index takes us past the ones too costly).  Sorted by cost, we must look at all of them which are cheap enough.
+long OSearch::seedpick(int g,float lim,const int *cnt,float above,long skip) const
+{
+	const OSGrpRec *gr= _rp[g];
+	const OSGrpCombos *rc= &(gr->_gc);
+	long nc= rc->Combos();
+	if (!rc->ByCost())
+	{
+		for (long i=rc->NextCheapEnough(0,0,lim);i<nc;i= rc->NextCheapEnough(i+1,0,lim))
+		{
+			if (!IsBadVal(above)&&!(rc->Val(i)>above)) break;
+			bool clash= false;
+			for (int k=0;k<gr->_np&&!clash;++k) clash= (cnt[gr->Item(i,k)]>0);
+			if (!clash&&skip--==0) return i;
+		}
+		return -1;
+	}
+	std::vector<std::pair<float,long> > fit;	// (-value, combo), so the most valuable sort first
+	for (long i=0;i<nc&&!(rc->Cost(i)>lim);++i)
+	{
+		if (!IsBadVal(above)&&!(rc->Val(i)>above)) continue;
+		bool clash= false;
+		for (int k=0;k<gr->_np&&!clash;++k) clash= (cnt[gr->Item(i,k)]>0);
+		if (clash) continue;
+		std::pair<float,long> f(-rc->Val(i),i);
+		if (skip>0) fit.push_back(f);
+		else if (fit.empty()) fit.push_back(f);
+		else if (f<fit[0]) fit[0]= f;
+	}
+	if ((long)fit.size()<=skip) return -1;
+	std::nth_element(fit.begin(),fit.begin()+skip,fit.end());
+	return fit[skip].second;
+}
 
-	// Setup tcol
-	if (_tcol) delete [] _tcol;
-	_tcol= new int [_cs];
+// Until the search adds its first collection it has no threshold, so can only prune by cost, and in a cost-ordered scan that first collection can be a long time coming.  So we find some good ones greedily beforehand.  Seed t takes the t-th most valuable combo which fits at the first level, then fills each level in turn with its most valuable combo which leaves enough for the cheapest picks of the levels below.  That tends to starve the last levels, so we then repeatedly swap one level's combo for the most valuable one the rest of the collection leaves room for, until no swap helps.  The constraints are only tested at the end, and a seed which violates them is dropped.  Each seed is checked and summed exactly as the search does, so it's one the search would add too.  The search thus will find each again, and the memory manager turns those away.
+int OSearch::WarmStart(int n)
+{
+	OSrchMtxCtl mtx(this);
+	if (!_st||n<=0) return 0;
+	float mtol= _oc->MaxCostTol();
+	std::vector<int> cnt(_oc->NumItems(),0);	// Times each item is used
+	std::vector<long> cur(_ng);		// Combo chosen at each level
+	int *tcol= new int [_cs];
+	for (int t=0;t<n;++t)
+	{
+		// Greedy fill
+		std::fill(cnt.begin(),cnt.end(),0);
+		float rcost= _oc->MaxCost();
+		int g= 0;
+		for (;g<_ng;++g)
+		{
+			const OSGrpRec *gr= _rp[g];
+			long i= seedpick(g,rcost-gr->_rlcost+mtol,&(cnt[0]),BadVal(),(g==0)?t:0);
+			if (i<0) break;
+			cur[g]= i;
+			for (int k=0;k<gr->_np;++k) cnt[gr->Item(i,k)]++;
+			rcost-= gr->_gc.Cost(i);
+		}
+		if (g==0) break;	// Run out of first combos
+		if (g<_ng) continue;
 
-	// Do the work
-	search(_oc->CTol(),_oc->MaxCost(),0.0,0,debug);
+		// Improve by swaps
+		bool better= true;
+		while (better)
+		{
+			better= false;
+			float tc= 0;
+			for (g=0;g<_ng;++g) tc+= _rp[g]->_gc.Cost(cur[g]);
+			for (g=0;g<_ng;++g)
+			{
+				const OSGrpRec *gr= _rp[g];
+				float cc= gr->_gc.Cost(cur[g]);
+				for (int k=0;k<gr->_np;++k) cnt[gr->Item(cur[g],k)]--;
+				long j= seedpick(g,_oc->MaxCost()+mtol-(tc-cc),&(cnt[0]),gr->_gc.Val(cur[g]),0);
+				if (j>=0)
+				{
+					tc+= gr->_gc.Cost(j)-cc;
+					cur[g]= j;
+					better= true;
+				}
+				for (int k=0;k<gr->_np;++k) cnt[gr->Item(cur[g],k)]++;
+			}
+		}
 
-	// Done
+		// Would the search take it?
+		rcost= _oc->MaxCost();
+		float val= 0;
+		for (g=0;g<_ng;++g)
+		{
+			const OSGrpRec *gr= _rp[g];
+			float cc= gr->_gc.Cost(cur[g]);
+			if (cc+gr->_rlcost>rcost+mtol) break;
+			rcost-= cc;
+			val+= gr->_gc.Val(cur[g]);
+			for (int k=0;k<gr->_np;++k)
+				tcol[_tloc[g]+k]= gr->Item(cur[g],k);
+		}
+		if (g<_ng||_oc->TestConstraints(tcol)>=0) continue;
+		if (!_m->AddSeed(tcol,&(cur[0]),val)) continue;
+		++_nseed;
+		if (IsBadVal(_wsval)||val>_wsval) _wsval= val;
+	}
+	delete [] tcol;
+	if (_nseed>0)
+	{
+		publish(_m->GetBar(),_m->GetMinAllowed());
+		_wsthr= minallowed();
+	}
+	if (_debug & 2) printf("Warm start: seeded %d of %d collections, best value %f, threshold %f\n",_nseed,n,_wsval,_wsthr);
+	return _nseed;
+}
+
+int OSearch::Continue(long maxnodes)
+{
+	OSrchMtxCtl mtx(this);
+	if (!_st) return -1;
+	if (_stop.load()) return 0;
+	bool done= true;
+	if (_nw==1) done= run(_st[0],maxnodes);
+	else if (!_pdone)
+	{
+		// Each task's results are ordered after everything already held (the seeds), with room for every leaf of its subtree.  If that's more than fits in a long, each gets as much as fits, and ties beyond that many in a task are left unordered.
+		_seqbase= _m->GetNextSeq();
+		_seqstep= std::min(_rp[_npre-1]->_rcombos,(LONG_MAX-1-_seqbase)/_ntask);
+		OWorkPool pool(_nw);
+		OSearchJob job(this);
+		pool.Run(job,_ntask);
+		_pdone= true;
+		done= !_stop.load();
+		if (_debug & 2) printf("Parallel search: %d workers, %d prefix levels, %ld stolen\n",_nw,_npre,pool.NumStolen());
+		long nr= 0;
+		for (int w=0;w<_nw;++w)
+		{
+			nr+= _st[w]._res->GetNumRec();
+			_m->Merge(*(_st[w]._res));
+			delete _st[w]._res;
+			_st[w]._res= NULL;
+		}
+		if (_debug & 2) printf("Merged %ld worker results into %ld\n",nr,_m->GetNumRec());
+	}
+	sumcounters();
+	if (done&&fabs(Coverage()-1)>1e-9) printf("ERROR: OSearch completed but accounted for %.9f of the state space\n",Coverage());	// Serial and parallel must both count every leaf once
+	return done?1:0;
+}
+
+void OSearch::sumcounters(void)
+{
+	memset(_pcnt,0,sizeof(long)*NumCounters());
+	_cov= 0;
+	for (int w=0;w<_nw;++w)
+	{
+		for (int i=0;i<NumCounters();++i)
+			addcnt(_pcnt[i],_st[w]._pcnt[i]);
+		_cov+= _st[w]._cov;
+	}
+}
+
+// A node pruned or analyzed accounts for all the leaves beneath it.  Leaves failing the memory manager or constraint tests are analyzed first, so are counted just once.
+double OSearch::Coverage(void) const
+{
+	if (!_rp||!_pcnt) return 0;
+	double tot= 1;
+	for (int g=0;g<_ng;++g) tot*= _rp[g]->Combos();
+	if (tot<=0) return 1;
+	return (_cov+_pcnt[CntAnal()])/tot;
+}
+
+// The analyzed budget is shared, so we publish our count as we go.  It thus may be overshot by up to SPOLLNODES leaves per worker.
+bool OSearch::poll(OSState &s)
+{
+	if (_stop.load(std::memory_order_relaxed)) return true;
+	int why= StopNone();
+	if (_cancel&&_cancel->load(std::memory_order_relaxed)) why= StopCancel();
+	else if (_maxanal>0)
+	{
+		long a= s._pcnt[CntAnal()];
+		long n= _nanal.fetch_add(a-s._apub)+(a-s._apub);
+		s._apub= a;
+		if (n>=_maxanal) why= StopBudget();
+	}
+	if (why==StopNone()&&_tend>0&&monotime()>=_tend) why= StopDeadline();
+	if (why==StopNone()) return false;
+	int z= StopNone();
+	_why.compare_exchange_strong(z,why);
+	_stop.store(true);
 	return true;
 }
 
+long OSearch::NumNodes(void) const
+{
+	long n= 0;
+	for (int w=0;w<_nw&&_st;++w) n+= _st[w]._nnn;
+	return n;
+}
+
+// Duplicate items only can arise between groups which share items.  For each level we find the items it shares with the levels above it.  If there are none (always the case when the primary feature is a partition) the level needn't test at all.  Otherwise it tests each combo against the bitset of items chosen above it when it branches, rather than finding the dup at every leaf of the subtree.  Where the shared items fit into fewer bitset words than the level has picks, we precompute a mask per combo so the test is a few word-ANDs.
+void OSearch::setupdups(void)
+{
+	int ni= _oc->NumItems();
+	_nwd= (ni+63)/64;
+	_lastdup= -1;
+	std::vector<uint64_t> seen(_nwd,0);	// Items in levels above
+	std::vector<uint64_t> gb(_nwd);		// Items in this level
+	std::vector<int> mwi;
+	for (int g=0;g<_ng;++g)
+	{
+		OSGrpRec *gr= _rp[g];
+		gr->_chkdup= false;
+		gr->ClearMasks();
+		std::fill(gb.begin(),gb.end(),0);
+		for (int j=0;j<gr->_ni;++j) gb[gr->_i[j]>>6]|= 1ULL<<(gr->_i[j]&63);
+		mwi.clear();
+		for (int k=0;k<_nwd;++k)
+		{
+			if (gb[k]&seen[k]) mwi.push_back(k);
+			seen[k]|= gb[k];
+		}
+		if (mwi.empty()) continue;
+		gr->_chkdup= true;
+		_lastdup= g;
+		if ((int)mwi.size()<=gr->_np&&gr->Combos()*(long)mwi.size()<=(1L<<22))
+		{
+			// gb becomes just the shared items
+			std::vector<uint64_t> ov(_nwd,0);
+			for (int g2=0;g2<g;++g2)
+				for (int j=0;j<_rp[g2]->_ni;++j)
+				{
+					int it= _rp[g2]->_i[j];
+					ov[it>>6]|= gb[it>>6]&(1ULL<<(it&63));
+				}
+			gr->BuildMasks(mwi.size(),&(mwi[0]),&(ov[0]));
+		}
+	}
+	if (_debug & 2)
+		for (int g=0;g<_ng;++g)
+			if (_rp[g]->_chkdup) printf("Level %d (group %d) tests for dups %s\n",g,_rp[g]->_g,_rp[g]->_cmask?"by combo mask":"item by item");
+}
+
+// The combo cull keeps a combo only if it's not dominated (and the cap only if it's among the best), so the trade which would make an assignment canonical might need a dropped combo.  We don't break symmetry then, since we'd lose item sets.
+void OSearch::setupsym(void)
+{
+	int ni= _oc->NumItems();
+	std::vector<std::vector<bool> > in(_ng,std::vector<bool>(ni,false));	// Group membership, by level
+	for (int g=0;g<_ng;++g)
+	{
+		_rp[g]->ClearSym();
+		for (int j=0;j<_rp[g]->_ni;++j) in[g][_rp[g]->_i[j]]= true;
+	}
+	if (_oc->ComboTol()>=0) return;
+	for (int g=0;g<_ng;++g)
+		if (_rp[g]->_gc.Capped()) return;
+	for (int g=1;g<_ng;++g)
+	{
+		OSGrpRec *gr= _rp[g];
+		std::vector<int> lev;
+		for (int k=0;k<g;++k)
+		{
+			bool ov= false;
+			for (int j=0;j<gr->_ni&&!ov;++j) ov= in[k][gr->_i[j]];
+			if (ov) lev.push_back(k);
+		}
+		if (lev.empty()) continue;
+		int ns= lev.size();
+		long nc= gr->Combos();
+		long no= 0;
+		gr->_nsym= ns;
+		gr->_symlev= new int [ns];
+		gr->_symoff= new long [ns];
+		for (int k=0;k<ns;++k)
+		{
+			gr->_symlev[k]= lev[k];
+			gr->_symoff[k]= no;
+			no+= _rp[lev[k]]->Combos();
+		}
+		gr->_symmy= new int [nc*ns];
+		gr->_symot= new int [no];
+		for (int k=0;k<ns;++k)
+		{
+			const OSGrpRec *kr= _rp[lev[k]];
+			bool low= (kr->_g<gr->_g);
+			for (long i=0;i<nc;++i)
+			{
+				int key= INT_MAX;
+				for (int j=0;j<gr->_np;++j)
+				{
+					int it= gr->Item(i,j);
+					if (in[lev[k]][it]) key= std::min(key,low?it:-it);
+				}
+				gr->_symmy[i*ns+k]= key;
+			}
+			for (long i=0;i<kr->Combos();++i)
+			{
+				int key= INT_MIN;
+				for (int j=0;j<kr->_np;++j)
+				{
+					int it= kr->Item(i,j);
+					if (in[g][it]) key= std::max(key,low?it:-it);
+				}
+				gr->_symot[gr->_symoff[k]+i]= key;
+			}
+		}
+		if (_debug & 2) printf("Level %d (group %d) breaks symmetry with %d earlier levels\n",g,gr->_g,ns);
+	}
+}
+
+bool OSearch::noncanonical(const OSFrame *stk,int g,long i) const
+{
+	const OSGrpRec *gr= _rp[g];
+	const int *my= gr->_symmy+i*gr->_nsym;
+	for (int k=0;k<gr->_nsym;++k)
+		if (my[k]<gr->_symot[gr->_symoff[k]+stk[gr->_symlev[k]]._i]) return true;
+	return false;
+}
+
+bool OSearch::conflicts(const OSState &s,int g,long i) const
+{
+	const OSGrpRec *gr= _rp[g];
+	const uint64_t *u= s._used+(long)g*_nwd;
+	if (gr->_cmask)
+	{
+		const uint64_t *m= gr->_cmask+i*gr->_nmw;
+		for (int k=0;k<gr->_nmw;++k)
+			if (u[gr->_mwi[k]]&m[k]) return true;
+		return false;
+	}
+	for (int k=0;k<gr->_np;++k)
+	{
+		int it= _lv[g].Item(i,k);
+		if (u[it>>6]&(1ULL<<(it&63))) return true;
+	}
+	return false;
+}
+
+inline void OSearch::markused(OSState &s,int g,long i) const
+{
+	const uint64_t *u= s._used+(long)g*_nwd;
+	uint64_t *un= s._used+(long)(g+1)*_nwd;
+	memcpy(un,u,sizeof(uint64_t)*_nwd);
+	for (int k=0;k<_lv[g]._np;++k)
+	{
+		int it= _lv[g].Item(i,k);
+		un[it>>6]|= 1ULL<<(it&63);
+	}
+}
+
+void OSearch::setupplan(void)
+{
+	delete [] _lv;
+	_lv= new OSLevel [_ng];
+	for (int g=0;g<_ng;++g)
+	{
+		const OSGrpRec *gr= _rp[g];
+		OSLevel &lv= _lv[g];
+		lv._nc= gr->Combos();
+		lv._np= gr->_np;
+		lv._tloc= _tloc[g];
+		lv._bycost= gr->_gc.ByCost();
+		lv._mrc= gr->_rlcost;
+		lv._mrv= gr->_rbval;
+		lv._rleaves= gr->_rleaves;
+		lv._v= gr->_gc.Vals();
+		lv._c= gr->_gc.Costs();
+		lv._iw= _m->ItemWidth();
+		lv._it= AlignedNew<char>(lv._nc*lv._np*lv._iw);
+		for (long i=0;i<lv._nc;++i)
+			for (int k=0;k<lv._np;++k)
+				SetItemAt(lv._it,lv._iw,i*lv._np+k,gr->Item(i,k));
+	}
+}
+
+// The budget tables.  Unlike _rbval, which takes the best combo of every remaining group regardless of cost, these account for the fact that the remaining groups have to share what's left of the budget.  We bin costs (rounding each combo's down, so it's still an upper bound) and combine the groups from the last level up: the best value from level g within b bins is the best over level g's combos of its value plus the best from level g+1 within the bins left over.  For each bin count only the most valuable combo of level g matters, and only if it beats every cheaper bin, so the combination is cheap.  Costs must be nonnegative for binning to underestimate them, so we don't build the tables otherwise.
+void OSearch::setupbounds(void)
+{
+	delete [] _sbt;
+	_sbt= NULL;
+	_nb= 0;
+	if (_bmode!=1) return;
+	float budget= _oc->MaxCost()+_oc->MaxCostTol();
+	int nb= _oc->BoundBins();
+	if (budget<=0||nb<1) return;
+	_bq= budget/nb;
+	long rl= nb+1;
+	float *t= new float [(long)(_ng+1)*rl];
+	for (long b=0;b<rl;++b) t[_ng*rl+b]= 0;
+	std::vector<float> best(rl);
+	std::vector<int> bins;		// Bins which improve on all cheaper ones
+	for (int g=_ng-1;g>=0;--g)
+	{
+		const OSGrpCombos *rc= &(_rp[g]->_gc);
+		std::fill(best.begin(),best.end(),BadVal());
+		for (long i=0;i<rc->Combos();++i)
+		{
+			float c= rc->Cost(i);
+			float v= rc->Val(i);
+			if (c<0)
+			{
+				delete [] t;
+				return;
+			}
+			double k= floor(c/_bq);
+			if (k>nb) continue;	// Never fits
+			if (IsBadVal(best[(int)k])||v>best[(int)k]) best[(int)k]= v;
+		}
+		bins.clear();
+		float bv= BadVal();
+		for (int k=0;k<rl;++k)
+			if (!IsBadVal(best[k])&&(IsBadVal(bv)||best[k]>bv))
+			{
+				bins.push_back(k);
+				bv= best[k];
+			}
+		float *tr= t+g*rl;
+		const float *tn= tr+rl;
+		for (long b=0;b<rl;++b)
+		{
+			float x= BadVal();
+			for (size_t j=0;j<bins.size()&&bins[j]<=b;++j)
+			{
+				float y= tn[b-bins[j]];
+				if (IsBadVal(y)) continue;
+				y+= best[bins[j]];
+				if (IsBadVal(x)||y>x) x= y;
+			}
+			tr[b]= x;
+		}
+	}
+	_sbt= t;
+	_nb= nb;
+	if (_debug & 2)
+	{
+		float bb= _sbt[_nb];
+		float cb= 0;
+		for (int g=0;g<_ng;++g) cb+= _rp[g]->_bval;
+		printf("Budget tables: %d bins of %f.  Best value within budget %f (vs %f ignoring it)\n",_nb,_bq,bb,cb);
+	}
+}
+
+inline float OSearch::bndval(int g,float budget) const
+{
+	if (budget<0) return BadVal();
+	double b= floor(budget/_bq);
+	return _sbt[g*(long)(_nb+1)+((b>_nb)?_nb:(long)b)];
+}
+
+// The tables are nondecreasing in the bin count, so we want the first bin which reaches v.
+float OSearch::bndcost(int g,float v) const
+{
+	const float *tr= _sbt+g*(long)(_nb+1);
+	if (IsBadVal(tr[_nb])||tr[_nb]<v) return BadCost();
+	long lo= 0;
+	long hi= _nb;
+	while (lo<hi)
+	{
+		long m= (lo+hi)/2;
+		if (!IsBadVal(tr[m])&&tr[m]>=v) hi= m;
+		else lo= m+1;
+	}
+	return lo*_bq;
+}
+
+// The value-ordered search asks whether the remaining budget buys enough value, and the cost-ordered one whether the value still needed costs more than is left.  These are the same test, but each is phrased in terms of the quantity its ordering tracks.  With no threshold yet, we just check that the remaining groups fit at all.
+bool OSearch::bndprune(int g,float cc,float cv,float rcost,float val,float mv) const
+{
+	float budget= rcost-cc+_oc->MaxCostTol();
+	if (IsBadVal(mv)) return IsBadVal(bndval(g+1,budget));
+	float need= mv-val-cv-BNDEPSILON*(1+fabs(mv));
+	if (_rp[g]->_gc.ByCost())
+	{
+		float c= bndcost(g+1,need);
+		return (IsBadCost(c)||c>budget);
+	}
+	float v= bndval(g+1,budget);
+	return (IsBadVal(v)||v<need);
+}
+
+// A task is a choice of combo for each of the first _npre levels (t is the mixed-radix combo number, last prefix level varying fastest).  We walk the prefix applying the same pruning tests as search() would and then search the rest of the tree beneath it.  Since each task only covers a single combo at each prefix level, a prune anywhere in the prefix removes just this task's subtree.  Siblings are tested (and counted) by their own tasks.
+void OSearch::runtask(OSState &s,long t)
+{
+	if (_stop.load(std::memory_order_relaxed)) return;	// Leave the rest uncovered
+	s._rseq= _seqbase+t*_seqstep;
+	s._rlast= s._rseq+_seqstep-1;
+	float rcost= _oc->MaxCost();
+	float val= 0.0;
+	long r= t;
+	for (int g=_npre-1;g>=0;--g)
+	{
+		long nc= _rp[g]->Combos();
+		s._stk[g]._i= r%nc;
+		r/= nc;
+	}
+	for (int g=0;g<_npre;++g)
+	{
+		long i= s._stk[g]._i;
+		s._stk[g]._rcost= rcost;
+		s._stk[g]._val= val;
+		OSGrpCombos *rc= &(_rp[g]->_gc);
+		float cc= rc->Cost(i);
+		float cv= rc->Val(i);
+		float mv= minallowed();
+		++s._nnn;
+		bool vbad= (!IsBadVal(mv)&&(cv+_rp[g]->_rbval+val<mv));
+		bool cbad= (cc+_rp[g]->_rlcost>rcost+_oc->MaxCostTol());
+		bool dbad= (!vbad&&!cbad&&_rp[g]->_chkdup&&conflicts(s,g,i));
+		bool sbad= (!vbad&&!cbad&&!dbad&&_rp[g]->_nsym&&noncanonical(s._stk,g,i));
+		bool bbad= (!vbad&&!cbad&&!dbad&&!sbad&&_sbt&&bndprune(g,cc,cv,rcost,val,mv));
+		if (vbad||cbad||dbad||sbad||bbad)
+		{
+			double pruned= _rp[_npre-1]->_rleaves;	// Just our subtree.  The tasks sharing our prefix down to g each count their own.
+			addcnt(s._pcnt[CntPruned()],pruned);
+			if (dbad) cover(s,CntDup(),pruned);
+			else if (sbad) cover(s,CntSym(),pruned);
+			else if (bbad) cover(s,CntBudget(),pruned);
+			else if (rc->ByCost()?cbad:vbad) cover(s,CntStrict(),pruned);		// Would have been a strict prune in the serial search
+			else cover(s,CntWeak(),pruned);
+			if (vbad||bbad) seedcredit(s,mv,pruned);
+			if (vbad&&!cbad) topkcredit(s,cv+_rp[g]->_rbval+val,pruned);
+			else if (bbad&&!bndprune(g,cc,cv,rcost,val,_thrc.load(std::memory_order_relaxed))) addcnt(s._pcnt[CntTopK()],pruned);
+			return;
+		}
+		_lv[g].Put(i,s._tcol+_lv[g]._tloc);
+		s._ci[g]= i;
+		if (g<_lastdup) markused(s,g,i);
+		rcost-= cc;
+		val+= cv;
+	}
+	start(s,_npre,rcost,val);
+	run(s,0);
+}
+
 // Utility function for dumping 
-static std::string getstatestr(long i,int g,int ng,OSGrpRec **rp)
+static std::string getstatestr(long i,int g,int ng,OSGrpRec **rp,const OSFrame *stk)
 {
 	char buf[128];
 	std::string x= "";
@@ -316,7 +1542,7 @@ static std::string getstatestr(long i,int g,int ng,OSGrpRec **rp)
 		{
 			if (j>0) x+= ":";
 			x+= "(";
-			long cnum= rp[j]->_c;
+			long cnum= stk[j]._i;
 			for (int k=0;k<rp[j]->_np;++k)
 			{
 				if (k>0) x+= ",";
@@ -354,171 +1580,388 @@ static std::string getstatestr(long i,int g,int ng,OSGrpRec **rp)
 	return x;
 }
 
-#define PRINTSTATE(c,n)		if (debug & 32) printf("%2s [%20ld] %s C:%.1f*%.1f*%.1f V:%.1f*%.1f*%.1f\n",c,(long)(n), getstatestr(i,g,_ng,_rp).c_str(), _oc->MaxCost()-rcost,cc,mrc,val,cv,mrv);
+// Enter level g, given the cost still available and the value so far.
+void OSearch::push(OSState &s,int g,float rcost,float val)
+{
+	s._sp= g;
+	s._stk[g]._i= 0;
+	s._stk[g]._rcost= rcost;
+	s._stk[g]._val= val;
+	if (_debug & 16)
+		printf("search: g:%d rcost:%f val:%f ctol:%f\n",g,rcost,val,_oc->CTol());
+}
 
+// Prime the stack to search everything beneath level g.  The levels above g must already hold their cursors.
+void OSearch::start(OSState &s,int g,float rcost,float val)
+{
+	s._base= g;
+	push(s,g,rcost,val);
+}
 
+#define PRINTSTATE(c,n)		if (_debug & 32) printf("%2s [%20.0f] %s C:%.1f*%.1f*%.1f V:%.1f*%.1f*%.1f\n",c,(double)(n), getstatestr(i,g,_ng,_rp,s._stk).c_str(), _oc->MaxCost()-rcost,cc,mrc,val,cv,mrv);
 
-// minval= (max coll val so far)*(1-ctol)
-// search takes a position starting at group g and cost c and value v so far.   It then cycles over all choices in group g and beyond. 
-void OSearch::search(float ctol,float rcost,float val,int g,int debug)
+// minval= max((max coll val so far)*(1-ctol), the worst we hold once full)
+// This is the search itself.  Conceptually it is a set of nested loops, one per group, but we keep the loop state for every level in an explicit stack (s._stk) rather than recursing.  Frame g holds the cursor for group g along with the cost still available and the value accumulated by the groups before it.  s._sp is the level we're working on.  The inner loop scans the combos of one level, keeping the cursor in a register, and only writes it back when it descends, finishes the level or suspends.  Everything lives in s, so we can stop before any combo and pick up again later exactly where we left off.  Returns true if the search below s._base is finished, false if we suspended because maxnodes (if >0) more combos were visited or stopped early (see poll()).
+bool OSearch::run(OSState &s,long maxnodes)
 {
-	static long nnn= 0;
-	if (debug & 16)
-		printf("search: g:%d rcost:%f val:%f ctol:%f\n",g,rcost,val,ctol);
-
-	// Cycle over all combos in group g
-	long nc= _rp[g]->Combos();
-	OSGrpCombos *rc= &(_rp[g]->_gc);
-	float mv= _m->GetMinAllowed();
-	long rcombos= _rp[g]->_rcombos;
-	for (long i=0;i<nc;++i)		// Cycle over the combos in the requested order (already sorted)
+	long stopat= (maxnodes>0)?(s._nnn+maxnodes):-1;
+	long pollat= s._nnn+SPOLLNODES;
+	long chkat= (stopat>=0&&stopat<pollat)?stopat:pollat;	// Next time we must stop and think
+	float mtol= _oc->MaxCostTol();
+	while (s._sp>=s._base)
 	{
-		++nnn;
-		_rp[g]->_c= i;			// Set for future use
-		float cc= rc->Cost(i);		// The cost of our current group's picks
-		float cv= rc->Val(i);		// The value of our current group's picks
-		assert(!IsBadCost(cc));
-		assert(!IsBadVal(cv));
+		int g= s._sp;
+		OSFrame &f= s._stk[g];
+		const OSGrpRec *gr= _rp[g];
+		const OSGrpCombos *rc= &(gr->_gc);
+		const OSLevel &lv= _lv[g];
+		long nc= lv._nc;
+		float rcost= f._rcost;
+		float val= f._val;
+		float mrc= lv._mrc;		// Min cost of all remaining groups
+		float mrv= lv._mrv;		// Max value of all remaining groups
+		double rleaves= lv._rleaves;	// Leaves beneath each of our combos
+		bool bycost= lv._bycost;
+		bool descend= false;
+		long i= f._i;
+		for (;i<nc;++i)		// Cycle over the combos in the requested order (already sorted)
+		{
+			if (s._nnn>=chkat)
+			{
+				if ((stopat>=0&&s._nnn>=stopat)||(s._nnn>=pollat&&poll(s)))	// Suspend or stop.  The stack is our state, so we just need to save the cursor.
+				{
+					f._i= i;
+					return false;
+				}
+				pollat= s._nnn+SPOLLNODES;
+				chkat= (stopat>=0&&stopat<pollat)?stopat:pollat;
+			}
+			++s._nnn;
+			float mv= minallowed();		// Re-read every time since other workers may have raised it
+			float cc= lv.Cost(i);		// The cost of our current group's picks
+			float cv= lv.Val(i);		// The value of our current group's picks
+			assert(!IsBadCost(cc));
+			assert(!IsBadVal(cv));
 
-		float mrc= _rp[g]->_rlcost;	// Min cost of all remaining groups
-		float mrv= _rp[g]->_rbval;	// Max value of all remaining groups
+			// We now prune by value and cost if possible.  HOWEVER, because we are moving in different ways depending on bycost, the effect (all remaining or just this branch) of pruning is reversed.  We always perform the potentially more aggressive pruning first!
+			if (!bycost)
+			{
+				// If best value is too low, prune this and ALL remaining choices because we're moving in decreasing order of value so all remaining choices will be worse.  Check this first since most extensive pruning!
+				if (!OGlobal::IsBadVal(mv)&&(cv+mrv+val<mv))
+				{
+					double pruned= (double)(nc-i)*rleaves;
+					addcnt(s._pcnt[CntPruned()],pruned);
+					cover(s,CntStrict(),pruned);
+					seedcredit(s,mv,pruned);
+					topkcredit(s,cv+mrv+val,pruned);
+					PRINTSTATE(">C",-pruned)
+					break;
+				}
 
-		// We now prune by value and cost if possible.  HOWEVER, because we are moving in different ways depending on bycost, the effect (all remaining or just this branch) of pruning is reversed.  We always perform the potentially more aggressive pruning first!
-		if (!_bycost)
-		{
-			// If best value is too low, prune this and ALL remaining choices because we're moving in decreasing order of value so all remaining choices will be worse.  Check this first since most extensive pruning!
-			if (!OGlobal::IsBadVal(mv)&&(cv+mrv+val<mv))
+				// Prune this combo if best cost is too high.  So is every combo up to the next one cheap enough (or the one where the value test above ends the scan, whichever comes first), so skip straight there.
+				if (cc+mrc>rcost+mtol)
+				{
+					long j= rc->NextCheapEnough(i+1,mrc,rcost+mtol);
+					if (j>i+1&&!OGlobal::IsBadVal(mv)&&lv.Val(j-1)+mrv+val<mv) j= rc->FirstTooPoor(i+1,mrv,val,mv);
+					double pruned= (double)(j-i)*rleaves;
+					addcnt(s._pcnt[CntPruned()],pruned);
+					cover(s,CntWeak(),pruned);
+					PRINTSTATE("=C",-pruned)
+					i= j-1;
+					continue;
+				}
+			}
+			else
 			{
-				long pruned= (long)(nc-i)*rcombos;
-				_pcnt[CntPruned()]+= pruned;
-				_pcnt[CntStrict()]+= pruned;
-				PRINTSTATE(">C",-pruned)
-				break;
+				// Prune this and all remaining combos if best cost is too high
+				if (cc+mrc>rcost+mtol)
+				{
+					double pruned= (double)(nc-i)*rleaves;
+					addcnt(s._pcnt[CntPruned()],pruned);
+					cover(s,CntStrict(),pruned);
+					PRINTSTATE("<V",-pruned)
+					break;
+				}
+
+				// If best value is too low, prune just combo.  Likewise every combo up to the next valuable enough one (or the one where the cost test above ends the scan), so skip straight there.
+				if (!OGlobal::IsBadVal(mv)&&(cv+mrv+val<mv))
+				{
+					long j= rc->NextGoodEnough(i+1,mrv,val,mv);
+					if (j>i+1&&lv.Cost(j-1)+mrc>rcost+mtol) j= rc->FirstTooCostly(i+1,mrc,rcost+mtol);
+					double pruned= (double)(j-i)*rleaves;
+					addcnt(s._pcnt[CntPruned()],pruned);
+					cover(s,CntWeak(),pruned);
+					seedcredit(s,mv,pruned);
+					topkcredit(s,cv+mrv+val,pruned);
+					PRINTSTATE("=V",-pruned)
+					i= j-1;
+					continue;
+				}
 			}
 
-			// Prune just this combo if best cost is too high
-			if (cc+mrc>rcost+_oc->MaxCostTol())
+			// Prune just this combo if it reuses an item chosen above
+			if (gr->_chkdup&&conflicts(s,g,i))
 			{
-				long pruned= rcombos;
-				_pcnt[CntPruned()]+= pruned;
-				_pcnt[CntWeak()]+= pruned;
-				PRINTSTATE("=C",-pruned)
+				double pruned= rleaves;
+				addcnt(s._pcnt[CntPruned()],pruned);
+				cover(s,CntDup(),pruned);
+				PRINTSTATE("DP",-pruned)
 				continue;
 			}
-		}
-		else
-		{
-			// Prune this and all remaining combos if best cost is too high
-			if (cc+mrc>rcost+_oc->MaxCostTol())
+
+			// Prune just this combo if it assigns the items to groups non-canonically.  The same items are reached through the canonical assignment.
+			if (gr->_nsym&&noncanonical(s._stk,g,i))
 			{
-				long pruned= (long)(nc-i)*rcombos;
-				_pcnt[CntPruned()]+= pruned;
-				_pcnt[CntStrict()]+= pruned;
-				PRINTSTATE("<V",-pruned)
-				break;
+				double pruned= rleaves;
+				addcnt(s._pcnt[CntPruned()],pruned);
+				cover(s,CntSym(),pruned);
+				PRINTSTATE("SY",-pruned)
+				continue;
 			}
 
-			// If best value is too low, prune just combo.
-			if (!OGlobal::IsBadVal(mv)&&(cv+mrv+val<mv))
+			// Prune just this combo if the remaining budget can't buy enough value.  The classic tests above ignore the budget, so this catches a lot more.  Not monotone in either ordering, so never a strict prune.
+			if (_sbt&&g<_ng-1&&bndprune(g,cc,cv,rcost,val,mv))
 			{
-				long pruned= rcombos;
-				_pcnt[CntPruned()]+= pruned;
-				_pcnt[CntWeak()]+= pruned;
-				PRINTSTATE("=V",-pruned)
+				double pruned= rleaves;
+				addcnt(s._pcnt[CntPruned()],pruned);
+				cover(s,CntBudget(),pruned);
+				seedcredit(s,mv,pruned);
+				if (!bndprune(g,cc,cv,rcost,val,_thrc.load(std::memory_order_relaxed))) addcnt(s._pcnt[CntTopK()],pruned);
+				PRINTSTATE("BT",-pruned)
 				continue;
 			}
-		}
 
-		//// It seems we don't need to prune.  Should we delegate to next level?
+			//// It seems we don't need to prune.  Should we delegate to next level?
 
-		// Copy current combo into tcol
-		for (int k=0;k<_rp[g]->_np;++k)
-		{
-			int inum= _rp[g]->Item(i,k);
-			_tcol[_tloc[g]+k]= inum;
-		}
+			// Copy current combo into tcol.  This completes the collection if we're the last level.
+			lv.Put(i,s._tcol+lv._tloc);
+			s._ci[g]= i;
 
-		if (g<_ng-1)
-		{
-			search(ctol,rcost-cc,val+cv,g+1,debug);
-			continue;
-		}
+			if (g<_ng-1)
+			{
+				f._i= i;
+				if (g<_lastdup) markused(s,g,i);
+				push(s,g+1,rcost-cc,val+cv);
+				descend= true;
+				break;
+			}
 
-		///// Apparently we're in the last group.  Well, let's test the collection.
-		_pcnt[CntAnal()]++;
+			///// Apparently we're in the last group.  Well, let's test the collection.
+			s._pcnt[CntAnal()]++;
 
-		// Accumulate the collection value, cost --- and dump info if requested
-		float tv= 0;
-		float tc= 0;
-		for (int j=0;j<_ng;++j)
-		{
-			long cnum= _rp[j]->_c;
-			tv+= _rp[j]->_gc.Val(cnum);
-			cv+= _rp[j]->_gc.Cost(cnum);
-		}
+			// The collection value.  Summing along the stack is the same (and in the same order) as summing each level's value.
+			float tv= val+cv;
 
-		// First, let's do the easy test against the memory manager
-		if (!_m->CanAdd(tv))
-		{
-			_pcnt[CntPruned()]++;
-			_pcnt[CntCantAdd()]++;
-			PRINTSTATE("NV",-1)
+			// First, let's do the easy test against the memory manager.  Workers just test the shared threshold and leave the rest to their own buffer's Add(), since it may take a tie the plain test would turn away.
+			if ((_nw==1)?(!_m->CanAdd(tv)):(IsBadVal(tv)||(!IsBadVal(mv)&&tv<mv)))
+			{
+				addcnt(s._pcnt[CntPruned()],1);
+				s._pcnt[CntCantAdd()]++;
+				seedcredit(s,mv,1);
+				PRINTSTATE("NV",-1)
+				continue;
+			}
 
-			continue;
+			// Test against constraints
+			int cviol= _oc->TestConstraints(s._tcol);
+			if (cviol>=0)
+			{
+				s._pcnt[NumIntCnts()+cviol]++;
+				addcnt(s._pcnt[CntPruned()],1);
+				s._pcnt[CntConstrain()]++;
+				char buf[128];
+				sprintf(buf,"C%1d",cviol);
+				PRINTSTATE(buf,-1)
+				continue;
+			}
+
+			// Now we have a valid collection
+			bool dup= false;
+			OCollMM *m= (_nw==1)?_m:s._res;
+			if (!m->Add(((_debug & 64)!=0),s._tcol,s._ci,tv,&dup,(_nw==1)?-1:((s._rseq<s._rlast)?s._rseq++:s._rseq)))
+			{
+				if (_nw>1||dup)	// We already have better, or these very items
+				{
+					addcnt(s._pcnt[CntPruned()],1);
+					s._pcnt[CntCantAdd()]++;
+					PRINTSTATE("NV",-1)
+					continue;
+				}
+				PRINTSTATE("ER",-1)
+				printf("ERROR: FAILED TO ADD ENTRY %ld\n",s._nnn);
+			}
+			else
+			{
+				s._pcnt[CntAdded()]++;
+				publish(m->GetBar(),m->MinAllowedFor(tv));	// Min val for a collection allowed at this point.  Update everybody in case needed
+				PRINTSTATE("++",1)
+			}
 		}
+		if (descend) continue;
+
+		// Done with this level, so move on to the next combo of the level above
+		f._i= nc;
+		--s._sp;
+		if (s._sp>=s._base) s._stk[s._sp]._i++;
+	}
+	return true;
+}
 
-		// Test for duplicate items, while populating dummy collection and getting cost/value
-		memset(_icnt,0,sizeof(int)*_oc->NumItems());
-		bool hasdup= false;
-		int ncc= 0;
-		for (int j=0;j<_ng&&!hasdup;++j)
+// One random dive from the root, as in Knuth's estimate of the size of a backtrack tree.  At each level we scan the combos just as run() would against the fixed threshold mv, then carry on beneath one of the survivors picked at random.  Each level's scan is weighted by the number of ways there are to reach it (the product of the survivor counts above), so on average the total is the number of combos the whole search would visit.  Likewise for the collections it would analyze.
+void OSearch::dive(OSState &s,float mv,uint64_t &rng,long &nvis,double &nodes,double &anal)
+{
+	float mtol= _oc->MaxCostTol();
+	float rcost= _oc->MaxCost();
+	float val= 0.0;
+	double w= 1;
+	std::vector<long> surv;
+	for (int g=0;g<_ng;++g)
+	{
+		OSGrpRec *gr= _rp[g];
+		const OSGrpCombos *rc= &(gr->_gc);
+		long nc= gr->Combos();
+		float mrc= gr->_rlcost;
+		float mrv= gr->_rbval;
+		bool bycost= rc->ByCost();
+		long nv= 0;
+		surv.clear();
+		for (long i=0;i<nc;++i)
 		{
-			long cnum= _rp[j]->_c;
-			for (int k=0;k<_rp[j]->_np;++k)
+			++nv;
+			float cc= rc->Cost(i);
+			float cv= rc->Val(i);
+			bool vbad= (!OGlobal::IsBadVal(mv)&&(cv+mrv+val<mv));
+			bool cbad= (cc+mrc>rcost+mtol);
+			if (bycost?cbad:vbad) break;
+			if (cbad)
+			{
+				long j= rc->NextCheapEnough(i+1,mrc,rcost+mtol);
+				if (j>i+1&&!OGlobal::IsBadVal(mv)&&rc->Val(j-1)+mrv+val<mv) j= rc->FirstTooPoor(i+1,mrv,val,mv);
+				i= j-1;
+				continue;
+			}
+			if (vbad)
 			{
-				int inum= _rp[j]->Item(cnum,k);
-				if (_icnt[inum]>0) { hasdup= true; break; }
-				_tcol[ncc]= inum;
-				_icnt[inum]++;
-				++ncc;
+				long j= rc->NextGoodEnough(i+1,mrv,val,mv);
+				if (j>i+1&&rc->Cost(j-1)+mrc>rcost+mtol) j= rc->FirstTooCostly(i+1,mrc,rcost+mtol);
+				i= j-1;
+				continue;
 			}
-			if (hasdup) break;
+			if (gr->_chkdup&&conflicts(s,g,i)) continue;
+			if (gr->_nsym&&noncanonical(s._stk,g,i)) continue;
+			if (_sbt&&g<_ng-1&&bndprune(g,cc,cv,rcost,val,mv)) continue;
+			surv.push_back(i);
 		}
-		if (hasdup)
+		nvis+= nv;
+		nodes+= w*nv;
+		if (surv.empty()) break;
+		if (g==_ng-1)
 		{
-			_pcnt[CntPruned()]++;
-			_pcnt[CntDup()]++;
-			PRINTSTATE("DP",-1)
-			continue;
+			anal+= w*surv.size();
+			break;
 		}
-		assert(ncc==_cs);
+		rng^= rng<<13;		// xorshift64
+		rng^= rng>>7;
+		rng^= rng<<17;
+		long i= surv[rng%surv.size()];
+		w*= surv.size();
+		s._stk[g]._i= i;
+		if (g<_lastdup) markused(s,g,i);
+		rcost-= rc->Cost(i);
+		val+= rc->Val(i);
+	}
+}
 
-		// Test against constraints
-		int cviol= _oc->TestConstraints(_tcol);
-		if (cviol>=0)
+// The real search has no threshold to begin with, and how soon it finds one depends on the plan, so we run each candidate for probenodes combos and take the threshold it reaches.  We then estimate the work of a search held at that threshold by random dives, until they've scanned probenodes combos between them.  This is pessimistic, since the threshold keeps rising, but it's fair to all the candidates and penalizes the plans which are slow to find good collections.  The dives are seeded the same way every time, so the choice is repeatable.
+bool OSearch::Tune(const OConfig &x,long probenodes,int *order,bool *bycost,int debug)
+{
+	int ng= x.NumPrimaryGroups();
+	if (ng<=0||probenodes<=0||!order||!bycost) return false;
+	typedef std::pair<std::vector<int>,std::vector<int> > PLAN;	// Order and scan directions
+	std::vector<PLAN> cand(1);
+	for (int g=0;g<ng;++g) cand[0].second.push_back(x.PlanByCost()?x.PlanByCost()[g]:x.IsSearchByCost());
+	bool *bc= new bool [ng];
+	double best= -1;
+	size_t bestc= 0;
+	double tend= (x.TimeLimit()>0)?(monotime()+x.TimeLimit()):0;	// The time limit covers all the probes together
+	for (size_t c=0;c<cand.size();++c)
+	{
+		double tlim= 0;
+		if (tend>0)
 		{
-			_pcnt[NumIntCnts()+cviol]++;
-			_pcnt[CntPruned()]++;
-			_pcnt[CntConstrain()]++;
-			char buf[128];
-			sprintf(buf,"C%1d",cviol);
-			PRINTSTATE(buf,-1)
-			continue;
+			tlim= tend-monotime();
+			if (tlim<=0) break;
+		}
+		for (int g=0;g<ng;++g) bc[g]= cand[c].second[g];
+		OCollMM m(x.CollectionSize(),x.ResNumb(),x.MaxRes(),x.CTol(),x.ItemWidth());
+		OSearch p;
+		if (!p.prepare(x,(c>0)?&(cand[c].first[0]):x.PlanOrder(),bc,x.IsGroupLowToHigh(),1,&m,tlim,0)||p.Continue(probenodes)<0)
+		{
+			delete [] bc;
+			return false;
+		}
+		if (p.StopReason()!=StopNone()) break;	// Out of time (or cancelled), so make do with what we have
+		bool empty= false;
+		for (int g=0;g<ng;++g)
+			if (p._r[g].Combos()<=0) empty= true;
+		if (empty) break;	// The cull left a group with nothing, so there's nothing to search and no plan to choose
+		if (c==0)
+		{
+			// Only now do we know x's order and how many combos each group has, so can list the other candidates.  x's own plan goes first, so it wins ties.
+			p.GetPlan(order,bc);
+			cand[0].first.assign(order,order+ng);
+			std::vector<std::pair<long,int> > nc;
+			for (int g=0;g<ng;++g) nc.push_back(std::pair<long,int>(p._r[g].Combos(),g));
+			std::sort(nc.begin(),nc.end());
+			std::vector<std::vector<int> > ords(3);
+			ords[0]= cand[0].first;
+			for (int i=0;i<ng;++i) ords[1].push_back(nc[i].second);
+			ords[2].assign(ords[1].rbegin(),ords[1].rend());
+			for (size_t o=0;o<ords.size();++o)
+				for (int d=1;d<5;++d)
+				{
+					PLAN pl(ords[o],cand[0].second);
+					for (int g=0;g<ng;++g) pl.second[g]= (d==2||d==4);	// All by value or all by cost
+					if (d>2) pl.second[pl.first[ng-1]]= (d==3);		// Except the last level
+					if (std::find(cand.begin(),cand.end(),pl)==cand.end()) cand.push_back(pl);
+				}
 		}
 
-		// Now we have a valid collection
-		if (!_m->Add(((debug & 64)!=0),_tcol,tv)) 
+		// The probe is over, so its stack is ours to dive with
+		float mv= p.minallowed();
+		uint64_t rng= 0x9E3779B97F4A7C15ULL;
+		long nvis= 0;
+		long ndive= 0;
+		double nodes= 0;
+		double anal= 0;
+		while (nvis<probenodes)
 		{
-			PRINTSTATE("ER",-1)
-			printf("ERROR: FAILED TO ADD ENTRY %ld\n",nnn);
+			long nv0= nvis;
+			p.dive(p._st[0],mv,rng,nvis,nodes,anal);
+			++ndive;
+			if (nvis==nv0) break;	// Scanned nothing, so neither will any other dive
 		}
-		else
+		double est= (nodes+TUNEANALCOST*anal)/ndive;
+		if (debug & 2)
 		{
-			_pcnt[CntAdded()]++;
-			mv= _m->GetMinAllowed();	// Min val for a collection allowed at this point.  Update in case needed
-			PRINTSTATE("++",1)
+			printf("Tune: plan");
+			for (int i=0;i<ng;++i) printf(" %d%c",cand[c].first[i],cand[c].second[cand[c].first[i]]?'c':'v');
+			printf(" reached threshold %f, est %.4g combos and %.4g analyzed (%ld dives)\n",mv,nodes/ndive,anal/ndive,ndive);
 		}
+		if (best<0||est<best)
+		{
+			best= est;
+			bestc= c;
+		}
+	}
+	delete [] bc;
+	if (best<0) return false;	// Didn't even finish the first candidate
+	for (int i=0;i<ng;++i)
+	{
+		order[i]= cand[bestc].first[i];
+		bycost[i]= cand[bestc].second[i];
 	}
+	return true;
 }
 
 std::string OSearch::NameOfCnt(int n)
@@ -531,6 +1974,10 @@ std::string OSearch::NameOfCnt(int n)
 	else if (n==5) return "PrunedCantAdd";
 	else if (n==6) return "PrunedDup";
 	else if (n==7) return "PrunedTotConst";
+	else if (n==8) return "PrunedBudget";
+	else if (n==9) return "PrunedSym";
+	else if (n==10) return "PrunedSeed";
+	else if (n==11) return "PrunedTopK";
 	else
 	{
 		char buf[40];
@@ -2,20 +2,34 @@
 #define OSEARCHDEFFLAG
 #include <string>
 #include <algorithm>
+#include <inttypes.h>
+#include <limits.h>
+#include <assert.h>
+#include <atomic>
 #include "OConfig.h"
 #include "OMutex.h"
 #include "OGlobal.h"
+#include "OKernel.h"
 
 // Because costs often arrive as integers, but we use floats, we need to make sure we don't disallow values which exceed the maximum only due to rounding issues.  For that reason, we require a tiny threshold above the maxcost overall.  For more general applications this may need to be changed.
 #define RCOSTEPSILON (0.01)
 
-// Utility record
-struct OSGCRec
+// The budget tables sum values in a different order than the search does, so we give their bound a tiny relative slack to avoid pruning a collection which ties the threshold exactly.
+#define BNDEPSILON (1e-5)
+
+// How often (in combos visited) each worker checks whether it should stop early
+#define SPOLLNODES (1L<<16)
+
+// When auto-tuning the search plan, the cost of analyzing a collection (testing the constraints and trying to add it) in units of combos visited
+#define TUNEANALCOST (6.0)
+
+// A state of the combo generator: the positions (in the items sorted best first) making up a combo, and which of them we're moving.  See OSGrpCombos::build().
+struct OSGCState
 {
-	OSGCRec(long n,float v,float c) : _n(n), _v(v), _c(c) {}
-	long _n;		// The combo number (index)
-	float _v;		// The value
-	float _c;		// The cost
+	double _k;		// Sort key of the combo (its value, or minus its cost)
+	long _p;		// Where its positions start in the generator's pool
+	int _m;			// The position being moved
+	bool operator<(const OSGCState &x) const { return (_k<x._k||(_k==x._k&&_p>x._p)); }	// For a max-heap on the key
 };
 
 // Utility class for creating n-tuple arrays ordered as requested by user
@@ -33,26 +47,45 @@ protected:
 	float *_c;		// Array of costs
 	const int *_n;		// Item numbers (for group).  We do not own.
 	int _ni;		// Length of _n array
+	long _nall;		// Number of combos there are in all, whether we kept them or not.  LONG_MAX if more.
+	bool _capped;		// Did we stop generating at the cap, leaving some which fit?
+	long _rp2;		// Number of leaves in the range index (a power of 2 >= _nc)
+	const OKernel *_kn;	// Scans runs before the range index is used.  Not owned.
+	float *_rix;		// Range index.  A segment tree (node k has children 2k, 2k+1 and leaf j is at _rp2+j) holding the min cost of each range when sorted by value and the max value of each range when sorted by cost.  Length 2*_rp2.
 
-	bool build(bool bycost,int np,int ni,float *v,float *c,const int *n);	// Build from number of items, list of item values, costs
-	static long nchoosem(int n,int m);	// Returns n choose m or 0 if error. 
-	static void initctr(int *c,int n);	// Initialize to [0,1,...n-1]
-	static bool nextctr(int *cl,int *cn,int np,int ni);	// Copy cl to cn and augments cn to the next ntuple (increases last value, then previous, etc, while maintaining strictly increasing sequence.  Returns false if no more combos possible
-	static bool OSGRecCmpValDesc(const OSGCRec &a,const OSGCRec &b);	// Comparator for sorting by descending value
-	static bool OSGRecCmpCostAsc(const OSGCRec &a,const OSGCRec &b);	// Comparator for sorting by ascending cost
+	bool build(bool bycost,int np,int ni,float *v,float *c,const int *n,float maxc,long cap,long &nbud);	// Build from number of items, list of item values, costs
+	void buildindex(void);		// Build _rix
+	void resize(long n);		// Reallocate _i, _v, _c with room for n combos, keeping the first _nc
+	bool sortcombos(void);		// Put the _nc combos into their final order
+	bool fromtuples(const int16_t *t,const float *iv,const float *ic,float *v,float *c,float maxc,long &nbud);	// Build from every combo (as OComboCache lists them, with iv, ic our items' values and costs) rather than generating them best first
+	bool fromsorted(const int16_t *t,const float *sv,const float *sc,float maxc,long &nbud);		// Likewise, but from them in their final order, with their sums
+	static long nchoosem(int n,int m);	// Returns n choose m, LONG_MAX if that's more, or 0 if error.
 public:
 	// Managament
-	OSGrpCombos(void) : _bycost(false), _np(0), _nc(0), _i(NULL), _v(NULL), _c(NULL), _n(NULL), _ni(0) {}
+	OSGrpCombos(void) : _bycost(false), _np(0), _nc(0), _i(NULL), _v(NULL), _c(NULL), _n(NULL), _ni(0), _nall(0), _capped(false), _rp2(0), _kn(OKernel::Pick(false)), _rix(NULL) {}
 	~OSGrpCombos(void);
-	bool Build(bool bycost,int np,int ni,float *v,float *c,const int *n);	// Build from number of items, list of item values, costs
+	bool Build(bool bycost,int np,int ni,float *v,float *c,const int *n,float maxc,long cap,long &nbud);	// Build from number of items, list of item values, costs.  Only the combos costing at most maxc are kept (nbud gets the number which cost more, as far as we looked), and if cap>0 only the first cap of those.  Combos are generated in order, so we never hold those we don't keep.  Sorted by cost the budget ends the run, but sorted by value (search modes 1 and 2) it doesn't, so every combo is still generated (though only those which fit are held) unless the cap stops it.
 	void Clear(void);
+	bool Cull(float gtol,int gntol,long &ndom);	// If gtol>=0, drop the combos with at least 1+gntol others of lower or equal cost and value above v*(1+gtol), returning the number in ndom.  Keeps the order.
+	void SetKernel(const OKernel *k) { if (k) _kn= k; }	// Scan with k (see OKernel).  The default is the widest the CPU supports.
 
 	// Info
 	long Combos(void) const { return _nc; }	// Return total number of combos
+	long AllCombos(void) const { return _nall; }	// Number there were before we dropped any.  LONG_MAX if more.
+	bool Capped(void) const { return _capped; }	// Did the cap drop some which fit?
+	bool ByCost(void) const { return _bycost; }	// Sorted by ascending cost (otherwise descending value)?
 	int RawItem(long i,int j) const { return (_np>0&&_i&&i>=0&&i<_nc&&j>=0&&j<_np)?_i[_np*i+j]:-1; }	// Return item j in combo i.  Indexed 0..ni-1.  -1 if out of range
 	int Item(long i,int j) const { int k= RawItem(i,j); return (_n&&k>=0&&k<_ni)?_n[k]:-1; }	// Return item j in combo i, as actual item # overall.  -1 if out of range
 	float Val(long i) const { return (_v&&i>=0&&i<_nc)?_v[i]:(BadVal()); }		// Return value of combo i
 	float Cost(long i) const { return (_c&&i>=0&&i<_nc)?_c[i]:(BadCost()); }		// Return cost of combo i
+	const float *Vals(void) const { return _v; }	// All the values, in order.  Cache line aligned.
+	const float *Costs(void) const { return _c; }	// Likewise the costs
+
+	// Skipping runs of combos which fail the search's pruning tests.  Each test is phrased exactly as the search phrases it, so we skip precisely the combos it would reject.  Returns Combos() if there is no such combo.
+	long NextCheapEnough(long i,float mrc,float lim) const;		// Sorted by value: first combo j>=i with !(Cost(j)+mrc>lim).  Uses the range index.
+	long NextGoodEnough(long i,float mrv,float val,float mv) const;	// Sorted by cost: first combo j>=i with !(Val(j)+mrv+val<mv).  Uses the range index.
+	long FirstTooCostly(long i,float mrc,float lim) const;		// Sorted by cost: first combo j>=i with Cost(j)+mrc>lim.  Binary search.
+	long FirstTooPoor(long i,float mrv,float val,float mv) const;	// Sorted by value: first combo j>=i with Val(j)+mrv+val<mv.  Binary search.
 };
 
 
@@ -69,20 +102,99 @@ public:
 	float _lcost;		// The sum of the bottom _np costs (the cheapest we can do)
 	float _rbval;		// The sum of _bval for all following groups (excluding current)
 	float _rlcost;		// The sum of _rlcost for all following groups (excluding current)
-	long _rcombos;		// Total combos involving all remaining groups (excluding current). 1 if last group.
+	long _rcombos;		// Total combos involving all remaining groups (excluding current). 1 if last group.  Saturates at LONG_MAX.
+	double _rleaves;	// The same in double, which doesn't saturate.  What a prune of one of our combos accounts for.
 	int _ni;		// The number of items in this group
 	const int *_i;		// Items in the group (length _ni) [not owned by us]
 	OSGrpCombos _gc;	// Appropriately sorted list of combos along with their values and costs
-	long _c;		// Current combo
-	bool Init(const OConfig &x,int i,bool bycost);	// Fill with info for ith group
+	bool Init(const OConfig &x,int i);	// Fill with info for ith group, apart from the combos
+	bool Build(const OConfig &x,bool bycost,float orc,long &ndom,long &nbud);	// Build our combos, keeping only those which fit given the least the other groups can cost (the number which don't go in nbud) and applying x's cap and combo cull (the number culled goes in ndom), and tighten _bval and _lcost to what's left
+
+	// Duplicate detection.  Set up by OSearch once the group order is known, since it depends on which groups are searched before us.
+	bool _chkdup;		// Do we share items with any earlier group (so must test for dups)?
+	int _nmw;		// Number of bitset words our combo masks cover (0 if we have no masks)
+	int *_mwi;		// Which bitset words they are.  Length _nmw
+	uint64_t *_cmask;	// Item mask for each combo, restricted to the _mwi words.  Length Combos()*_nmw.  NULL if we test item-by-item instead.
+	void BuildMasks(int nmw,const int *mwi,const uint64_t *ov);	// Build _cmask over the given words, keeping only the items in ov (a full-width bitset)
+	void ClearMasks(void);
+
+	// Symmetry breaking.  When groups overlap, the same item set can be reached by several assignments of its items to groups, and we only allow one.  Whenever item x picked for group g and item y picked for group h>g could trade places (x is in h and y in g), we require x<y.  The lexicographically least assignment of any item set passes, so nothing is lost.  We test this against each earlier level whose group overlaps ours by comparing a key for our combo with one for the combo chosen there: the assignment is non-canonical iff ours is lower.
+	int _nsym;		// Number of earlier levels whose group overlaps ours
+	int *_symlev;		// Those levels.  Length _nsym
+	int *_symmy;		// Key of each of our combos against each such level (Combos()*_nsym).  If that level's group is lower, the least of our items it also holds, otherwise minus the greatest.  INT_MAX if none.
+	int *_symot;		// Key of each combo of each such level against us.  If its group is lower, the greatest of its items we also hold, otherwise minus the least.  INT_MIN if none.  Level k's keys start at _symoff[k].
+	long *_symoff;		// Length _nsym
+	void ClearSym(void);
 
 	OSGrpRec(void);
-	~OSGrpRec(void) {}
+	~OSGrpRec(void) { ClearMasks(); ClearSym(); }
 	long Combos(void) const { return _gc.Combos(); }
 	int Item(long i,int j) const { return _gc.Item(i,j); }
 	void DumpCombos(FILE *f) const;	// List all combos and total value and cost for each
 };
 
+// One level of the search plan: everything the inner loop needs of the group searched there, flattened so it needn't go through the group record and its bounds-checked accessors.  Built by OSearch once the group order is known.  The accessors check bounds only in debug builds (without NDEBUG).
+struct OSLevel
+{
+	long _nc;		// Number of combos
+	int _np;		// Items per combo
+	int _tloc;		// Where our items go in a collection
+	bool _bycost;		// Combos are sorted by ascending cost (otherwise descending value)
+	float _mrc;		// _rlcost of the group
+	float _mrv;		// _rbval of the group
+	double _rleaves;	// _rleaves of the group
+	const float *_v;	// Value of each combo.  The group's own array, not owned.
+	const float *_c;	// Cost of each combo.  Likewise.
+	int _iw;		// Bytes per item # in _it: just enough for the number of items (see OGlobal::ItemWidth())
+	void *_it;		// Items of each combo as actual item #s overall.  Length _nc*_np, cache line aligned.  Owned.
+	OSLevel(void) : _nc(0), _np(0), _tloc(0), _bycost(false), _mrc(0), _mrv(0), _rleaves(0), _v(NULL), _c(NULL), _iw(4), _it(NULL) {}
+	~OSLevel(void) { free(_it); }
+	float Val(long i) const { assert(i>=0&&i<_nc); return _v[i]; }
+	float Cost(long i) const { assert(i>=0&&i<_nc); return _c[i]; }
+	int Item(long i,int k) const { assert(i>=0&&i<_nc&&k>=0&&k<_np); return OGlobal::GetItemAt(_it,_iw,i*_np+k); }
+	void Put(long i,int *d) const;	// Copy the items of combo i to d
+};
+
+template <class T> static inline void OSWiden(const T *s,int n,int *d) { for (int k=0;k<n;++k) d[k]= s[k]; }
+
+inline void OSLevel::Put(long i,int *d) const
+{
+	assert(i>=0&&i<_nc);
+	if (_iw==1) OSWiden((const uint8_t *)_it+i*_np,_np,d);
+	else if (_iw==2) OSWiden((const uint16_t *)_it+i*_np,_np,d);
+	else OSWiden((const int32_t *)_it+i*_np,_np,d);
+}
+
+// One level of the explicit search stack
+struct OSFrame
+{
+	long _i;		// Cursor (the current combo) for this level
+	float _rcost;		// Cost still available on entering this level
+	float _val;		// Value accumulated by the levels before this one
+};
+
+// Per-worker search state.  The serial search uses a single one of these and the parallel search one per worker, so nothing in here is ever shared between threads.  The stack is the entire state of a search in progress, so a search can be stopped and resumed from it.
+struct OSState
+{
+	OSFrame *_stk;		// The search stack.  Length ng
+	int _sp;		// Level presently being worked on.  <_base if done.
+	int _base;		// Level the search started from.  We're done once we pop above it.
+	int *_tcol;		// Dummy collection values.  Length cs.  Each level fills in its own slots as it goes.
+	long *_ci;		// The combo chosen at each level, likewise.  Length ng.
+	uint64_t *_used;	// Items chosen by the levels above each level, as bitsets of nwd words.  Level g's is at _used[g*nwd].  Length ng*nwd.
+	long *_pcnt;		// Pruning/etc counters.  Length NumCounters()
+	double _cov;		// Leaves accounted for by the prunes counted in Coverage().  In double, since past 2^63 the counters saturate.
+	long _nnn;		// Total combos visited
+	long _apub;		// Analyzed count already added to OSearch::_nanal
+	OCollMM *_res;		// This worker's results, merged into OSearch::_m once the tasks are done.  NULL in the serial search.  We own this.
+	long _rseq;		// Order of the next result among those of equal value: past those of the tasks before ours and in the order found below, so the same as the serial search's order
+	long _rlast;		// The last order our task may give
+	OSState(void) : _stk(NULL), _sp(-1), _base(0), _tcol(NULL), _ci(NULL), _used(NULL), _pcnt(NULL), _cov(0), _nnn(0), _apub(0), _res(NULL), _rseq(0), _rlast(0) {}
+	~OSState(void) { clear(); }
+	void Init(int ng,int cs,int nwd,int ncnt);
+	void clear(void);
+};
+
 class OSearch : public OMtxCtlBase, public OGlobal
 {
 private:
@@ -90,38 +202,124 @@ private:
 protected:
 	typedef OMtxCtl<OSearch> OSrchMtxCtl;
 	friend class OMtxCtl<OSearch>;
+	friend class OSearchJob;
 	OSGrpRec *_r;		// Length _ng.  We own this.
 	OSGrpRec **_rp;		// Pointers to the _r (for sorting)
 	const OConfig *_oc;
 	OCollMM *_m;		// Memory manager for result records.  NOT managed here.
 	int _ng;		// Number of groups
 	int _nc;		// Number of constraints
-	bool _bycost;		// We're ordered by cost instead of value
 	int _cs;		// Collection Size
+	int _debug;		// Debug flags passed to Prepare()
+
+	// Duplicate detection.  Only groups which share items with an earlier group need testing.  We do so when we branch, against a bitset of the items chosen above.
+	int _nwd;		// Words in an item bitset
+	int _lastdup;		// Last level which must test for dups (-1 if none, ex. the primary feature is a partition)
+
+	// Parallel search.  The tree is split into tasks, one per combination of combos in the first _npre levels of _rp, which are run on a work-stealing pool.  All workers prune against the same published threshold.  Each keeps its own top-K results, without locking, and raises the threshold to its own K-th value (K of them at least that good anywhere means nothing worse can make the cut).  Their results are merged into _m at the end, ordered among equal values as the serial search would have found them, so the ranking is the same as a serial run's.
+	int _nw;		// Number of workers (1 means serial)
+	int _npre;		// Number of levels in a task prefix
+	long _ntask;		// Number of tasks
+	bool _pdone;		// Have the tasks been run?
+	long _seqbase;		// Order of the first result of task 0
+	long _seqstep;		// Orders set aside for each task
+	OSState *_st;		// Per-worker state.  Length _nw
+	std::atomic<float> _thr;	// Published OCollMM::GetBar() value.  Only ever rises.
+	std::atomic<float> _thrc;	// Its ctol part alone (GetMinAllowed()), so we can tell which prunes only the top-K part made
+
+	// Budget tables (bound mode 1).  Costs are measured in bins of width _bq, each combo's cost being rounded down to a whole number of bins.  Row g of _sbt gives, for each number of bins b, the best value of any choice of combos from levels g onward whose binned costs sum to at most b.  Since binning only lowers costs this is an upper bound on the true value within a budget of b*_bq.  BadVal() if no choice fits.  Row _ng is all zero.
+	int _bmode;		// Bound mode (see OConfig)
+	int _nb;		// Number of bins (table rows have _nb+1 entries).  0 if no tables.
+	double _bq;		// Bin width
+	float *_sbt;		// The tables.  Length (_ng+1)*(_nb+1)
+
+	// Early stopping.  Each worker polls these every SPOLLNODES combos, so the checks cost nothing in the inner loop.
+	double _tend;		// Deadline (monotonic clock, in seconds).  0 if none.
+	long _maxanal;		// Budget of collections analyzed.  0 if none.
+	const std::atomic<bool> *_cancel;	// Cancellation token.  Not owned.  NULL if none.
+	std::atomic<long> _nanal;	// Collections analyzed, as published by the workers when they poll
+	std::atomic<bool> _stop;	// Set once we decide to stop.  Sticky.
+	std::atomic<int> _why;		// Why we stopped
+
+	// Warm start.  Collections found by a quick greedy search and seeded into the memory manager before the real search, so it has a threshold to prune against from the outset.
+	int _nseed;		// Number seeded
+	float _wsval;		// Best value seeded.  BadVal() if none.
+	float _wsthr;		// Threshold the search started with.  BadVal() if nothing was seeded.
+
+	OSLevel *_lv;		// The search plan, one per level.  Length _ng
 
 	// Used for diagnostics and tracking
-	long *_pcnt;		// Pruning/etc counters
-	int *_icnt;		// Count of items of each val (length ni) to test for dups!
-	int *_tcol;		// Dummy collection values
+	long *_pcnt;		// Pruning/etc counters (summed over workers at the end)
+	double _cov;		// OSState::_cov likewise
 	int *_tloc;		// Starting loc in tcol for each group
+
+	float minallowed(void) const { return _thr.load(std::memory_order_relaxed); }
+	void publish(float v,float c);		// Raise the shared threshold to v and its ctol part to c (each if higher)
+	static void addcnt(long &c,double n) { c= (n+(double)c<9.2e18)?(c+(long)n):LONG_MAX; }	// Add n to counter c, which saturates at LONG_MAX (a big state space prunes more than that)
+	static void cover(OSState &s,int k,double pruned) { addcnt(s._pcnt[k],pruned); s._cov+= pruned; }	// Count a prune in category k, which Coverage() sums
+	void topkcredit(OSState &s,float bound,double pruned) const { float c= _thrc.load(std::memory_order_relaxed); if (IsBadVal(c)||!(bound<c)) addcnt(s._pcnt[CntTopK()],pruned); }	// Count a prune by value of a node whose bound is bound, if the ctol part alone wouldn't have made it
+	void runtask(OSState &s,long t);	// Search the subtree of task t
+	void push(OSState &s,int g,float rcost,float val);	// Enter level g
+	void start(OSState &s,int g,float rcost,float val);	// Prime s to search everything beneath level g
+	bool run(OSState &s,long maxnodes);	// The search engine.  True when done, false if suspended after maxnodes (if >0) combos or stopped early
+	void sumcounters(void);		// Total up the worker counters
+	bool poll(OSState &s);		// Should we stop early?  If so, records why and sets _stop.
+	void setupdups(void);		// Decide which levels test for dups and build their masks
+	bool conflicts(const OSState &s,int g,long i) const;	// Does combo i of level g reuse an item chosen above?
+	void setupsym(void);		// Decide which levels must break symmetry and build their keys
+	bool noncanonical(const OSFrame *stk,int g,long i) const;	// Would combo i of level g make the assignment non-canonical, given the combos chosen above (in stk)?
+	void markused(OSState &s,int g,long i) const;	// Set the used items for level g+1 from level g's and combo i
+	void setupplan(void);		// Build _lv
+	void setupbounds(void);		// Build the budget tables
+	float bndval(int g,float budget) const;	// Best value obtainable from levels g onward within budget.  BadVal() if none.
+	float bndcost(int g,float v) const;	// Least cost needed to reach value v from levels g onward (the dual of bndval).  BadCost() if unreachable.
+	bool bndprune(int g,float cc,float cv,float rcost,float val,float mv) const;	// Do the budget tables rule out combo (cost cc, value cv) at level g?
+	long seedpick(int g,float lim,const int *cnt,float above,long skip) const;	// Most valuable combo of level g costing at most lim, using no item with a nonzero count in cnt and worth more than above (if not BadVal()).  The first skip such combos are passed over.  -1 if none.
+	void seedcredit(OSState &s,float mv,double pruned) const { if (!IsBadVal(_wsthr)&&!(mv>_wsthr)) addcnt(s._pcnt[CntSeed()],pruned); }	// Count a prune by value made against the warm start's threshold
+	void dive(OSState &s,float mv,uint64_t &rng,long &nvis,double &nodes,double &anal);	// One random dive for Tune().  Adds the combos scanned to nvis and the estimated combos visited and collections analyzed by the whole search to nodes and anal.
+	bool prepare(const OConfig &x,const int *order,const bool *bycost,bool grouplowtohigh,int nw,OCollMM *m,double tlim,int debug);	// Prepare() proper.  bycost has an entry per group.  If order is NULL, groups are ordered by combos as grouplowtohigh says.  Results go to m, searched by nw workers.  The search may take tlim seconds from now (0 for no limit).
+
 public:
 	OSearch(void);
 	~OSearch(void);
-	bool Search(const OConfig &x,bool bycost,bool grouplowtohigh,int debug);	// If bycost, scans each group from lowest to highest cost, otherwise (default) is from highest to lowest value.  grouplowtohigh says whether to move through groups from fewest combos to most (default is most combos to fewest).  NOTE that grouplowtohigh is completely independent of bycost and involves the group ordering, NOT the ordering of search within a group!  
-	void search(float ctol,float rcost,float val,int g,int debug);
+	bool Search(const OConfig &x,bool bycost,bool grouplowtohigh,int debug);	// If bycost, scans each group from lowest to highest cost, otherwise (default) is from highest to lowest value.  grouplowtohigh says whether to move through groups from fewest combos to most (default is most combos to fewest).  NOTE that grouplowtohigh is completely independent of bycost and involves the group ordering, NOT the ordering of search within a group!  The number of threads is taken from x.NumThreads().  Same as Prepare() followed by WarmStart(x.WarmStarts()) and Continue(0).
+	bool Prepare(const OConfig &x,bool bycost,bool grouplowtohigh,int debug);	// Precompute everything and position the search at its start, but don't search yet.
+	bool Prepare(const OConfig &x,const int *order,const bool *bycost,int debug);	// Same, but with an explicit plan.  order[l] is the group to search at level l and bycost[g] says whether to scan group g by cost.  Either may be NULL to follow x's smode.
+	static bool Tune(const OConfig &x,long probenodes,int *order,bool *bycost,int debug);	// Choose a plan from a set of candidates (x's own plan, which wins ties, and the fewest/most combos orders with various scan directions), picking the one with the least estimated work.  Each candidate is run serially for probenodes combos to see what threshold it reaches, and its work at that threshold is then estimated by random dives scanning probenodes combos in all.  order and bycost get an entry per group, as for Prepare().  The time limit of x covers all the probes.  False if we couldn't probe even x's own plan, or a group has no combos so there's nothing to tune.
+	void GetPlan(int *order,bool *bycost) const;	// The plan in use, as for Prepare()
+	int WarmStart(int n);		// Seed the results with up to n collections found greedily, before searching.  Each starts from a different choice at the first level, fills the rest greedily by value and then is improved by swapping one level's combo at a time.  Returns the number seeded.
+	int NumSeeded(void) const { return _nseed; }
+	float SeedValue(void) const { return _wsval; }		// Best value seeded.  BadVal() if none.
+	float SeedThreshold(void) const { return _wsthr; }	// Threshold the warm start gave the search.  BadVal() if none.
+	int Continue(long maxnodes);	// Search (some more).  If maxnodes>0, we suspend after visiting that many more combos and can be called again to carry on.  Returns 1 when the search is complete, 0 if suspended or stopped early (see StopReason()), -1 on error.  A parallel search always runs to completion unless stopped early.  Once stopped early, the search can't be continued.
+	long NumNodes(void) const;	// Combos visited so far
 	int NumCounters(void) const { return NumIntCnts()+_nc; }
+	int NumWorkers(void) const { return _nw; }
+	long NumTasks(void) const { return _ntask; }	// Number of parallel tasks (0 if serial)
 	long ReadCounter(int n) const { return (n>=0&&n<NumCounters())?_pcnt[n]:-1; }
+	int StopReason(void) const { return _why.load(); }	// Why we stopped early.  StopNone() if we didn't.
+	double Coverage(void) const;	// Fraction of the full (post-cull) state space the search has covered so far, whether by pruning or analyzing.  1 once complete.
+
+	// Early stop reasons.  The limits come from the OConfig passed to Prepare().
+	static int StopNone(void) { return 0; }
+	static int StopDeadline(void) { return 1; }	// The time limit expired
+	static int StopBudget(void) { return 2; }	// Analyzed the maximum number of collections
+	static int StopCancel(void) { return 3; }	// The cancellation token was set
 
 	// Diagnostic counter indices
-	static int NumIntCnts(void) { return 8; }	// Number of intrinsic counters
+	static int NumIntCnts(void) { return 12; }	// Number of intrinsic counters
 	static int CntAdded(void) { return 0; } 	// Total added to memory manager
 	static int CntAnal(void) { return 1; }		// Total analyzed (i.e. survived pruning)
 	static int CntPruned(void) { return 2; }	// Total pruned during search
 	static int CntStrict(void) { return 3; }	// Pruned node and all beyond it (cost or val)
 	static int CntWeak(void) { return 4; }		// Pruned just node (cost or val)
 	static int CntCantAdd(void) { return 5; }	// Pruned because failed addition test relative to existing records
-	static int CntDup(void) { return 6; }		// Pruned due to dup item
+	static int CntDup(void) { return 6; }		// Pruned due to dup item (the node and all beyond it)
 	static int CntConstrain(void) { return 7; }	// Pruned due to any constraint
+	static int CntBudget(void) { return 8; }	// Pruned by the budget tables but not by the classic tests (just the node)
+	static int CntSym(void) { return 9; }		// Pruned because the assignment of items to groups isn't the canonical one (just the node)
+	static int CntSeed(void) { return 10; }		// Of those pruned by value (including budget and CantAdd), how many were pruned against the warm start's threshold, before the search raised it.  An upper bound on what the warm start bought.
+	static int CntTopK(void) { return 11; }		// Of those pruned by value when branching, how many only because the results are full and they can't beat the worst of them
 	static std::string NameOfCnt(int n);	// Return string for counter n
 };
 
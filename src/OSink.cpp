@@ -0,0 +1,142 @@
+#include <signal.h>
+#include <string.h>
+#include "OSink.h"
+
+/////////// OCollStreamSink
+
+// SIGPIPE is ignored while any sink's pipe is open, so a reader which quits early just ends the stream rather than the whole process.  Its disposition from before the first was opened is put back once the last is closed.
+static OMutex sigmtx;
+static int npipes= 0;
+static struct sigaction oldpipe;
+
+static void holdsigpipe(bool hold)
+{
+	sigmtx.Lock();
+	if (hold&&npipes++==0)
+	{
+		struct sigaction ign;
+		memset(&ign,0,sizeof(ign));
+		ign.sa_handler= SIG_IGN;
+		sigemptyset(&ign.sa_mask);
+		sigaction(SIGPIPE,&ign,&oldpipe);
+	}
+	else if (!hold&&--npipes==0) sigaction(SIGPIPE,&oldpipe,NULL);
+	sigmtx.UnLock();
+}
+
+OCollStreamSink::~OCollStreamSink(void)
+{
+	close();
+}
+
+void OCollStreamSink::close(void)
+{
+	if (!_f) return;
+	if (_pipe)
+	{
+		pclose(_f);
+		holdsigpipe(false);
+	}
+	else fclose(_f);
+	_f= NULL;
+}
+
+bool OCollStreamSink::OpenFile(const char *path,bool text)
+{
+	OCSSMtxCtl mtx(this);
+	close();
+	if (!path||!*path) return false;
+	_f= fopen(path,text?"w":"wb");
+	_pipe= false;
+	_text= text;
+	return _f!=NULL;
+}
+
+bool OCollStreamSink::OpenPipe(const char *cmd,bool text)
+{
+	OCSSMtxCtl mtx(this);
+	close();
+	if (!cmd||!*cmd) return false;
+	holdsigpipe(true);
+	_f= popen(cmd,"w");
+	_pipe= true;
+	_text= text;
+	if (!_f) holdsigpipe(false);
+	return _f!=NULL;
+}
+
+void OCollStreamSink::put(char e,int64_t id)
+{
+	fwrite(&e,1,1,_f);
+	fwrite(&id,sizeof(id),1,_f);
+}
+
+void OCollStreamSink::Accept(int64_t id,const int *c,int clen,float v)
+{
+	OCSSMtxCtl mtx(this);
+	if (!_f) return;
+	if (_text)
+	{
+		fprintf(_f,"A %" PRId64 " %.7g",id,v);
+		for (int j=0;j<clen;++j) fprintf(_f," %d",c[j]);
+		fputc('\n',_f);
+		return;
+	}
+	put('A',id);
+	fwrite(&v,sizeof(v),1,_f);
+	_c.assign(c,c+clen);
+	fwrite(&(_c[0]),sizeof(uint32_t),clen,_f);
+}
+
+void OCollStreamSink::Retract(int64_t id)
+{
+	OCSSMtxCtl mtx(this);
+	if (!_f) return;
+	if (_text) fprintf(_f,"R %" PRId64 "\n",id);
+	else put('R',id);
+}
+
+void OCollStreamSink::Final(long n)
+{
+	OCSSMtxCtl mtx(this);
+	if (!_f) return;
+	if (_text) fprintf(_f,"F %ld\n",n);
+	else put('F',n);
+	fflush(_f);
+}
+
+void OCollStreamSink::Clear(void)
+{
+	OCSSMtxCtl mtx(this);
+	if (!_f) return;
+	if (_text) fprintf(_f,"C\n");
+	else put('C',0);
+}
+
+/////////// OCollCallbackSink
+
+void OCollCallbackSink::Accept(int64_t id,const int *c,int clen,float v)
+{
+	OCCSMtxCtl mtx(this);
+	if (!_fn) return;
+	_c.assign(c,c+clen);
+	_fn(id,&(_c[0]),clen,v);
+}
+
+void OCollCallbackSink::Retract(int64_t id)
+{
+	OCCSMtxCtl mtx(this);
+	if (_fn) _fn(id,NULL,0,0);
+}
+
+void OCollCallbackSink::Final(long n)
+{
+	OCCSMtxCtl mtx(this);
+	if (_fn) _fn(n,NULL,-1,0);	// The id, since a float can't hold every count
+}
+
+void OCollCallbackSink::Clear(void)
+{
+	OCCSMtxCtl mtx(this);
+	if (_fn) _fn(-2,NULL,0,0);
+}
@@ -0,0 +1,74 @@
+#ifndef OSINKDEFFLAG
+#define OSINKDEFFLAG
+
+#include <vector>
+#include <stdio.h>
+#include <inttypes.h>
+#include "OMutex.h"
+
+/* Result sinks.
+
+A sink is told of each collection as the collection store (OCollMM) accepts it, and of each one it later drops: when the threshold rises past it, when it's displaced once the store is full, or (in a parallel search) when it loses out as the threads' results are merged.  Each is known by an id, its record's order among those of equal value, which is unique among the results of a search.  So at any point the collections accepted and not since retracted include all the store holds, and once the results are prepared (OCollMM::InitResIter()) they are exactly the results.  They come in no particular order.
+
+In a parallel search each thread's buffer calls the sink, so it must be thread-safe.
+*/
+class OCollSink
+{
+public:
+	virtual ~OCollSink(void) {}
+	virtual void Accept(int64_t id,const int *c,int clen,float v)= 0;	// Collection c (clen items) of value v was accepted
+	virtual void Retract(int64_t id)= 0;		// The collection accepted as id was dropped
+	virtual void Final(long n) {}			// The results are prepared: the n accepted and not retracted
+	virtual void Clear(void) {}			// The results were discarded, so forget everything accepted so far
+};
+
+/* Writes the events to a file or a pipe.
+
+Binary: each event is a char and an int64 id.  'A' (accept) is followed by the value (float32) and clen item #s (uint32), 'R' (retract) by nothing.  'F' (final) and 'C' (clear) have no id but the number of results (int64) and 0 respectively.  All in native byte order.
+Text: a line for each, "A id value item item ...", "R id", "F n" or "C".
+*/
+class OCollStreamSink : public OCollSink, public OMtxCtlBase
+{
+private:
+	OCollStreamSink(const OCollStreamSink &x) {}
+protected:
+	typedef OMtxCtl<OCollStreamSink> OCSSMtxCtl;
+	friend class OMtxCtl<OCollStreamSink>;
+	FILE *_f;
+	bool _pipe;		// _f came from popen()
+	bool _text;		// Text rather than binary
+	std::vector<uint32_t> _c;	// Scratch for a collection's items
+	void put(char e,int64_t id);	// Write an event header
+	void close(void);
+public:
+	OCollStreamSink(void) : OMtxCtlBase(), _f(NULL), _pipe(false), _text(false), _c() {}
+	~OCollStreamSink(void);
+	bool OpenFile(const char *path,bool text);	// Write to path (replacing it)
+	bool OpenPipe(const char *cmd,bool text);	// Run cmd (with the shell) and write to its standard input.  SIGPIPE is ignored (process-wide) until it's closed.
+	bool IsOpen(void) const { return _f!=NULL; }
+	void Accept(int64_t id,const int *c,int clen,float v);
+	void Retract(int64_t id);
+	void Final(long n);
+	void Clear(void);
+};
+
+// Passes the events to a function.  It gets the items of an accepted collection, and NULL and 0 for a retraction.  Calls are serialized.  Final() is passed with the number of results as the id and clen -1, and Clear() with id -2.  Neither has items.
+typedef void (*OCollSinkFn)(int64_t id,const unsigned int *c,int clen,float v);
+class OCollCallbackSink : public OCollSink, public OMtxCtlBase
+{
+private:
+	OCollCallbackSink(const OCollCallbackSink &x) {}
+protected:
+	typedef OMtxCtl<OCollCallbackSink> OCCSMtxCtl;
+	friend class OMtxCtl<OCollCallbackSink>;
+	OCollSinkFn _fn;
+	std::vector<unsigned int> _c;	// Scratch for a collection's items
+public:
+	OCollCallbackSink(OCollSinkFn fn) : OMtxCtlBase(), _fn(fn), _c() {}
+	void Accept(int64_t id,const int *c,int clen,float v);
+	void Retract(int64_t id);
+	void Final(long n);
+	void Clear(void);
+};
+
+#endif